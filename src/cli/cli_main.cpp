@@ -13,6 +13,8 @@
 #include <script/functions/functions.hpp>
 #include <script/profiler.hpp>
 #include <data/format/formats.hpp>
+#include <data/symbol_font.hpp>
+#include <gfx/generated_image.hpp>
 #include <wx/process.h>
 #include <wx/wfstream.h>
 
@@ -101,6 +103,8 @@ bool CLISetInterface::run_script(ScriptP const& script) {
 		WITH_DYNAMIC_ARG(export_info, &ei);
 		Context& ctx = getContext();
 		ScriptValueP result = ctx.eval(*script,false);
+		// wait for the files written by the script
+		ei.finishWriting();
 		// show result (?)
 		cli << result->toCode() << ENDL;
 		return true;
@@ -162,9 +166,24 @@ void CLISetInterface::showUsage() {
 	cli << _("   :pwd                Print the current working directory.\n");
 	cli << _("   :cd                 Change the working directory.\n");
 	cli << _("   :! <command>        Perform a shell command.\n");
+	cli << _("   :caches             Show statistics on the image caches.\n");
 	cli << _("\n Commands can be abreviated to their first letter if there is no ambiguity.\n\n");
 }
 
+void CLISetInterface::showCacheStats() {
+	showCacheStats(_("generated images:"), generated_image_cache_stats());
+	showCacheStats(_("image files:     "), image_file_cache_stats());
+	showCacheStats(_("symbol images:   "), SymbolFont::imageCacheStats());
+}
+
+void CLISetInterface::showCacheStats(const String& name, const LruCacheStats& stats) {
+	cli << name
+	    << String::Format(_("%d hits, %d misses (%.1f%%), %d evictions, %d entries using %.1f of %.1f MB"),
+	                      (int)stats.hits, (int)stats.misses, 100 * stats.hitRate(), (int)stats.evictions,
+	                      (int)stats.entries, stats.cost / 1048576.0, stats.max_cost / 1048576.0)
+	    << ENDL;
+}
+
 void CLISetInterface::handleCommand(const String& command) {
 	try {
 		if (command.empty()) {
@@ -213,6 +232,8 @@ void CLISetInterface::handleCommand(const String& command) {
 				}
 			} else if (before == _(":pwd") || before == _(":p")) {
 				cli << ei.directory_absolute << ENDL;
+			} else if (before == _(":caches")) {
+				showCacheStats();
 			} else if (before == _(":!")) {
 				if (arg.empty()) {
 					cli.show_message(MESSAGE_ERROR,_("Give a shell command to execute."));
@@ -14,6 +14,8 @@
 #include <data/export_template.hpp>
 #include <script/profiler.hpp>
 
+struct LruCacheStats;
+
 // ----------------------------------------------------------------------------- : Command line interface
 
 class CLISetInterface : public SetView {
@@ -36,6 +38,8 @@ class CLISetInterface : public SetView {
 	
 	void showWelcome();
 	void showUsage();
+	void showCacheStats();
+	void showCacheStats(const String& name, const LruCacheStats& stats);
 	void handleCommand(const String& command);
 	#if USE_SCRIPT_PROFILING
 		void showProfilingStats(const FunctionProfile& parent, int level = 0);
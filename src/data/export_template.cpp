@@ -11,7 +11,9 @@
 #include <data/game.hpp>
 #include <data/set.hpp>
 #include <data/field.hpp>
+#include <data/format/image_writer.hpp>
 #include <util/io/package_manager.hpp>
+#include <util/parallel.hpp>
 
 // ----------------------------------------------------------------------------- : Export template, basics
 
@@ -53,3 +55,25 @@ IMPLEMENT_REFLECTION(ExportTemplate) {
 IMPLEMENT_DYNAMIC_ARG(ExportInfo*, export_info, nullptr);
 
 ExportInfo::ExportInfo() : allow_writes_outside(false) {}
+
+ImageWriterPool& ExportInfo::fileWriter() {
+	if (!file_writer) {
+		int writer_threads = parallel_thread_count();
+		if (!file_target) {
+			// the writers already encode images in parallel, don't start more threads than there are processors
+			PngOptions png;
+			png.threads = max(1, parallel_thread_count() / writer_threads);
+			file_target = shared(new FileImageTarget(png));
+		}
+		file_writer = shared(new ImageWriterPool(*file_target, writer_threads));
+	}
+	return *file_writer;
+}
+
+void ExportInfo::finishWriting() {
+	if (!file_writer) return;
+	// the next file will start a new pool, even if this one failed
+	ImageWriterPoolP writer;
+	swap(writer, file_writer);
+	writer->finish();
+}
@@ -19,6 +19,9 @@ DECLARE_POINTER_TYPE(Field);
 DECLARE_POINTER_TYPE(Style);
 DECLARE_POINTER_TYPE(ExportTemplate);
 DECLARE_POINTER_TYPE(Package);
+DECLARE_SHARED_POINTER_TYPE(CardBitmapExporter);
+DECLARE_SHARED_POINTER_TYPE(ImageWriterTarget);
+DECLARE_SHARED_POINTER_TYPE(ImageWriterPool);
 
 // ----------------------------------------------------------------------------- : ExportTemplate
 
@@ -60,6 +63,15 @@ struct ExportInfo {
 	String             directory_absolute; ///< The absolute path of the directory
 	map<String,wxSize> exported_images;	   ///< Images (from symbol font) already exported, and their size
 	bool               allow_writes_outside; ///< Can files outside the directory be written to?
+	CardBitmapExporterP card_exporter;     ///< Draws the card images for write_image_file, created when first needed
+	ImageWriterTargetP file_target;        ///< Writes the files for write_image_file and write_text_file
+	ImageWriterPoolP   file_writer;        ///< Encodes and writes those files in the background, created when first needed
+	
+	/// The background writer for files created by the export script
+	ImageWriterPool& fileWriter();
+	/// Wait until all files queued by the export script have been written
+	/** Throws an error listing the files that could not be written */
+	void finishWriting();
 };
 
 DECLARE_DYNAMIC_ARG(ExportInfo*, export_info);
@@ -12,11 +12,14 @@
 #include <util/prec.hpp>
 #include <util/error.hpp>
 #include <data/settings.hpp>
+#include <gfx/png_encoder.hpp>
 
 class Game;
 DECLARE_POINTER_TYPE(Set);
 DECLARE_POINTER_TYPE(Card);
 DECLARE_POINTER_TYPE(FileFormat);
+DECLARE_POINTER_TYPE(StyleSheet);
+class UnzoomedDataViewer;
 
 // ----------------------------------------------------------------------------- : FileFormat
 
@@ -91,9 +94,41 @@ FileFormatP mtg_editor_file_format();
 /// Export images for each card in a set to a list of files
 void export_images(Window* parent, const SetP& set);
 
+/// Receives progress updates from export_images
+class ExportImagesProgress {
+  public:
+	virtual ~ExportImagesProgress() {}
+	/// Called before each card is exported, and once more at the end with done == total
+	virtual void onProgress(size_t done, size_t total) = 0;
+};
+
+/// Options for export_images
+class ExportImagesOptions {
+  public:
+	ExportImagesOptions();
+	
+	FilenameConflicts conflicts;   ///< What to do with existing files, only used when writing to a directory
+	/// Only export cards that have changed since the previous export to the same directory
+	/** A fingerprint of everything that goes into a card's image is stored in a manifest in the output directory.
+	 *  Cards with the same fingerprint as in the previous export are not drawn again, if their file still exists.
+	 *  Only used when writing one file per card to a directory.
+	 */
+	bool   incremental;
+	int    jobs;                   ///< Number of threads that encode and write images, if <= 0 one per processor
+	String archive;                ///< If not empty, write the images to this zip file instead of to the directory
+	/// If both > 0, combine the cards into sprite sheets with this many columns and rows
+	/** The sheets are named sheet1.png, sheet2.png, etc., and sheets.json lists the position of each card */
+	int    sheet_columns, sheet_rows;
+	PngOptions png;                ///< How to encode PNG images, other file types use the wxImage handlers
+	ExportImagesProgress* progress; ///< Optional, receives progress updates
+};
+
 /// Export the image for each card in a list of cards
+/** Cards are drawn one at a time, the images are encoded and written by background threads.
+ *  The filename_template determines the name of each card's file (or its name in the sprite sheet index).
+ */
 void export_images(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts);
+                   const String& path, const String& filename_template, const ExportImagesOptions& options);
 
 /// Export the image of a single card
 void export_image(const SetP& set, const CardP& card, const String& filename);
@@ -101,6 +136,26 @@ void export_image(const SetP& set, const CardP& card, const String& filename);
 /// Generate a bitmap image of a card
 Bitmap export_bitmap(const SetP& set, const CardP& card);
 
+/// Generates bitmap images of many cards from the same set
+/** Keeps a viewer for each stylesheet alive between cards, so when consecutive cards
+ *  share a stylesheet only the card data changes, and the viewers, style images and fonts
+ *  prepared for the previous card are reused.
+ */
+class CardBitmapExporter {
+  public:
+	CardBitmapExporter(const SetP& set);
+	~CardBitmapExporter();
+	/// Generate a bitmap image of a card
+	Bitmap exportBitmap(const CardP& card);
+	/// Generate an image of a card, drawn offscreen without using a DC when the card is drawn anti-aliased
+	Image exportImage(const CardP& card);
+  private:
+	SetP set;
+	map<StyleSheetP, shared_ptr<UnzoomedDataViewer> > viewers;
+	/// The viewer to use for a card, showing that card
+	UnzoomedDataViewer& viewerFor(const CardP& card);
+};
+
 /// Export a set to Magic Workstation format
 void export_mws(Window* parent, const SetP& set);
 
@@ -9,23 +9,47 @@
 #include <util/prec.hpp>
 #include <util/tagged_string.hpp>
 #include <data/format/formats.hpp>
+#include <data/format/image_writer.hpp>
 #include <data/set.hpp>
+#include <data/game.hpp>
 #include <data/card.hpp>
 #include <data/stylesheet.hpp>
 #include <data/settings.hpp>
+#include <data/field/symbol.hpp>
 #include <render/card/viewer.hpp>
+#include <gfx/software_canvas.hpp>
+#include <gfx/generated_image.hpp>
+#include <gfx/png_encoder.hpp>
+#include <util/parallel.hpp>
+#include <util/hash.hpp>
+#include <util/io/reader.hpp>
+#include <util/io/writer.hpp>
+#include <util/io/package_manager.hpp>
 #include <wx/filename.h>
+#include <wx/wfstream.h>
+#include <wx/mstream.h>
+#include <wx/zipstrm.h>
 
 DECLARE_TYPEOF_COLLECTION(CardP);
+DECLARE_TYPEOF_COLLECTION(String);
+DECLARE_TYPEOF_COLLECTION(PackageDependencyP);
+DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA ValueP>);
+DECLARE_TYPEOF(map<String COMMA String>);
 
 // ----------------------------------------------------------------------------- : Single card export
 
 void export_image(const SetP& set, const CardP& card, const String& filename) {
-	Image img = export_bitmap(set, card).ConvertToImage();
+	Image img = CardBitmapExporter(set).exportImage(card);
 	img.SaveFile(filename);	// can't use Bitmap::saveFile, it wants to know the file type
 							// but image.saveFile determines it automagicly
 }
 
+Bitmap export_bitmap(const SetP& set, const CardP& card) {
+	return CardBitmapExporter(set).exportBitmap(card);
+}
+
+// ----------------------------------------------------------------------------- : CardBitmapExporter
+
 class UnzoomedDataViewer : public DataViewer {
   public:
 	UnzoomedDataViewer(bool use_zoom_settings)
@@ -44,12 +68,39 @@ Rotation UnzoomedDataViewer::getRotation() const {
 	}
 }
 
-Bitmap export_bitmap(const SetP& set, const CardP& card) {
+CardBitmapExporter::CardBitmapExporter(const SetP& set)
+	: set(set)
+{
 	if (!set) throw Error(_("no set"));
-	// create viewer
-	UnzoomedDataViewer viewer(!settings.stylesheetSettingsFor(set->stylesheetFor(card)).card_normal_export());
-	viewer.setSet(set);
-	viewer.setCard(card);
+}
+CardBitmapExporter::~CardBitmapExporter() {}
+
+UnzoomedDataViewer& CardBitmapExporter::viewerFor(const CardP& card) {
+	// find or create the viewer for this card's stylesheet
+	StyleSheetP stylesheet = set->stylesheetForP(card);
+	shared_ptr<UnzoomedDataViewer>& viewer = viewers[stylesheet];
+	if (!viewer) {
+		viewer = shared(new UnzoomedDataViewer(!settings.stylesheetSettingsFor(*stylesheet).card_normal_export()));
+		viewer->setSet(set);
+	}
+	viewer->setCard(card);
+	return *viewer;
+}
+
+Image CardBitmapExporter::exportImage(const CardP& card) {
+	UnzoomedDataViewer& viewer = viewerFor(card);
+	if (viewer.renderQuality() != QUALITY_AA) {
+		// sub pixel and aliased text can only be drawn by a DC
+		return exportBitmap(card).ConvertToImage();
+	}
+	RealSize size = viewer.getRotation().getExternalSize();
+	SoftwareCanvas canvas((int) size.width, (int) size.height);
+	viewer.draw(canvas);
+	return canvas.getImage();
+}
+
+Bitmap CardBitmapExporter::exportBitmap(const CardP& card) {
+	UnzoomedDataViewer& viewer = viewerFor(card);
 	// size of cards
 	RealSize size = viewer.getRotation().getExternalSize();
 	// create bitmap & dc
@@ -63,31 +114,381 @@ Bitmap export_bitmap(const SetP& set, const CardP& card) {
 	return bitmap;
 }
 
+// ----------------------------------------------------------------------------- : ZipImageTarget
+
+/// Write images into a single zip archive, names are names in the archive
+/** The images are stored as they are, since PNG and JPEG data doesn't get smaller by compressing it again.
+ *  Images are encoded in memory by the calling thread, only adding them to the archive is serialized.
+ */
+class ZipImageTarget : public ImageWriterTarget {
+  public:
+	ZipImageTarget(const String& filename, const PngOptions& png);
+	virtual bool save(const Image& img, const String& name, const PngOptions& png);
+	virtual bool saveText(const String& name, const String& text);
+	/// Finish writing the archive, throws an error on failure
+	void close();
+  private:
+	String             filename;
+	wxFileOutputStream file;
+	wxZipOutputStream  zip;
+	wxMutex            mutex; ///< Lock for writing to the zip stream
+	/// Add a file to the archive
+	bool add(const String& name, const void* data, size_t size, bool compress);
+};
+
+ZipImageTarget::ZipImageTarget(const String& filename, const PngOptions& png)
+	: ImageWriterTarget(png), filename(filename), file(filename), zip(file)
+{
+	if (!file.IsOk() || !zip.IsOk()) throw Error(_ERROR_("unable to open output file") + _("\n") + filename);
+}
+
+bool ZipImageTarget::save(const Image& img, const String& name, const PngOptions& png) {
+	wxMemoryOutputStream buffer;
+	if (!encode(img, name, buffer, png)) return false;
+	wxStreamBuffer* data = buffer.GetOutputStreamBuffer();
+	return add(name, data->GetBufferStart(), (size_t)buffer.GetLength(), false);
+}
+
+bool ZipImageTarget::saveText(const String& name, const String& text) {
+	size_t size;
+	wxCharBuffer utf8 = encodeText(text, size);
+	return add(name, utf8.data(), size, true);
+}
+
+bool ZipImageTarget::add(const String& name, const void* data, size_t size, bool compress) {
+	wxMutexLocker lock(mutex);
+	wxZipEntry* entry = new wxZipEntry(name);
+	entry->SetMethod(compress ? wxZIP_METHOD_DEFLATE : wxZIP_METHOD_STORE);
+	if (!zip.PutNextEntry(entry)) return false;
+	zip.Write(data, size);
+	return zip.CloseEntry();
+}
+
+void ZipImageTarget::close() {
+	if (!zip.Close() || !file.Close()) {
+		throw Error(_("Unable to write ") + filename);
+	}
+}
+
+// ----------------------------------------------------------------------------- : Card fingerprints
+
+/// Add the identity of a package to a fingerprint, it changes when the package is edited or updated
+void add_package_fingerprint(Fingerprint& fp, const Packaged& package) {
+	fp.add(package.relativeFilename());
+	fp.add(package.version.toString());
+	fp.add(package.lastModified().GetValue().ToString());
+}
+
+/// Add values to a fingerprint, including the contents of image and symbol files they refer to
+/** Returns false if a file can change without that being noticed */
+bool add_values_fingerprint(Fingerprint& fp, Set& set, const IndexMap<FieldP,ValueP>& values) {
+	FOR_EACH_CONST(v, values) {
+		fp.add(v->fieldP->name);
+		fp.add(v->value->toCode());
+		// the file name stays the same when a symbol is edited
+		LocalFileName file;
+		if (const ImageValueToImage* image = dynamic_cast<const ImageValueToImage*>(v->value.get())) {
+			file = image->getFilename();
+		} else if (const LocalSymbolFile* symbol = dynamic_cast<const LocalSymbolFile*>(v->value.get())) {
+			file = symbol->filename;
+		}
+		if (!file.empty()) {
+			String stamp = set.fileStamp(file);
+			if (stamp.empty()) return false;
+			fp.add(stamp);
+		}
+	}
+	return true;
+}
+
+/// Fingerprint of everything that goes into the exported image of a card
+/** That is: the program version, the game and stylesheet packages, the export settings,
+ *  the position of the card in the set and the number of cards,
+ *  and the values of the set, the card and its styling.
+ *  Scripts can look at the other cards, the position and count cover the common case of card numbers like "3/250".
+ *  Returns an empty string if the fingerprint can not be trusted, then the card should always be exported.
+ */
+String card_fingerprint(Set& set, const CardP& card, size_t position) {
+	Fingerprint fp;
+	fp.add(app_version.toString());
+	fp.add(String::Format(_("%d/%d"), (int)position, (int)set.cards.size()));
+	// packages
+	StyleSheetP stylesheet = set.stylesheetForP(card);
+	add_package_fingerprint(fp, *set.game);
+	add_package_fingerprint(fp, *stylesheet);
+	FOR_EACH(dep, stylesheet->dependencies) {
+		add_package_fingerprint(fp, *package_manager.openAny(dep->package, true));
+	}
+	// settings, see UnzoomedDataViewer
+	StyleSheetSettings& ss = settings.stylesheetSettingsFor(*stylesheet);
+	fp.add(String::Format(_("%d %g %g"), (int)ss.card_normal_export(), ss.card_zoom(), ss.card_angle()));
+	// values
+	if (!add_values_fingerprint(fp, set, set.data))                       return String();
+	if (!add_values_fingerprint(fp, set, card->data))                     return String();
+	if (!add_values_fingerprint(fp, set, set.stylingDataFor(card)))       return String();
+	if (!add_values_fingerprint(fp, set, card->extraDataFor(*stylesheet))) return String();
+	return fp.toString();
+}
+
+// ----------------------------------------------------------------------------- : ExportManifest
+
+/// Name of the manifest file in the directory that images are exported to
+const Char* export_manifest_name = _("mse-export-manifest.txt");
+
+/// A file written by export_images, and the fingerprint of the card on it
+class ExportManifestFile {
+  public:
+	ExportManifestFile() {}
+	ExportManifestFile(const String& name, const String& fingerprint) : name(name), fingerprint(fingerprint) {}
+	String name;
+	String fingerprint;
+	DECLARE_REFLECTION();
+};
+DECLARE_TYPEOF_COLLECTION(ExportManifestFile);
+
+IMPLEMENT_REFLECTION_NO_SCRIPT(ExportManifestFile) {
+	REFLECT(name);
+	REFLECT(fingerprint);
+}
+
+/// The files written by previous incremental exports to a directory
+class ExportManifest {
+  public:
+	/// Fingerprints of the cards, by filename (without the directory)
+	map<String,String> fingerprints;
+	
+	/// Read the manifest from a directory, if there is one
+	void read(const String& directory);
+	/// Write the manifest to a directory
+	void write(const String& directory);
+	
+	DECLARE_REFLECTION();
+};
+
+IMPLEMENT_REFLECTION_NO_SCRIPT(ExportManifest) {
+	// filenames can't be used as keys, so store a list
+	vector<ExportManifestFile> files;
+	if (reflector.isWriting()) {
+		FOR_EACH_CONST(f, fingerprints) files.push_back(ExportManifestFile(f.first, f.second));
+	}
+	REFLECT(files);
+	if (reflector.isReading()) {
+		FOR_EACH(f, files) fingerprints[f.name] = f.fingerprint;
+	}
+}
+
+void ExportManifest::read(const String& directory) {
+	String filename = directory + _("/") + export_manifest_name;
+	if (!wxFileExists(filename)) return; // first export, not an error
+	try {
+		wxFileInputStream stream(filename);
+		if (!stream.Ok()) return;
+		Reader reader(stream, nullptr, filename);
+		reader.handle_greedy(*this);
+	} catch (const Error&) {
+		// a damaged manifest just means that all cards are exported again
+		fingerprints.clear();
+	}
+}
+
+void ExportManifest::write(const String& directory) {
+	String filename = directory + _("/") + export_manifest_name;
+	wxFileOutputStream stream(filename);
+	if (!stream.Ok()) throw Error(_("Unable to write ") + filename);
+	Writer writer(stream, app_version);
+	writer.handle(*this);
+}
+
+// ----------------------------------------------------------------------------- : SpriteSheetWriter
+
+/// Quote a string for use in a JSON file
+String json_string(const String& str) {
+	String ret = _("\"");
+	for (size_t i = 0 ; i < str.size() ; ++i) {
+		Char c = str.GetChar(i);
+		if      (c == _('"'))  ret += _("\\\"");
+		else if (c == _('\\')) ret += _("\\\\");
+		else if (c < 0x20)     ret += String::Format(_("\\u%04x"), (int)c);
+		else                   ret += c;
+	}
+	return ret + _("\"");
+}
+
+/// Combines card images into sprite sheets, and keeps an index of where each card is
+/** Only the sheet that is being filled is kept in memory, full sheets are handed to an ImageWriterPool.
+ *  All cells on a sheet have the same size, a card with a different size starts a new sheet.
+ */
+class SpriteSheetWriter {
+  public:
+	/// Sheets are written as prefix + "sheet1.png", etc.
+	SpriteSheetWriter(ImageWriterPool& writers, const String& prefix, int columns, int rows);
+	
+	/// Add the image of a card to the current sheet
+	void add(const Image& img, const String& name);
+	/// Write the last sheet, returns the index of all sheets in JSON format
+	String finish();
+	
+  private:
+	ImageWriterPool& writers;
+	String prefix;
+	int    columns, rows;
+	Image  sheet;                   ///< The sheet being filled, if any
+	int    cell_width, cell_height; ///< Size of the cards on the current sheet
+	int    count;                   ///< Number of cards on the current sheet
+	int    sheet_count;             ///< Number of sheets so far
+	String index;                   ///< JSON for the finished sheets
+	String card_index;              ///< JSON for the cards on the current sheet
+	
+	/// Write the current sheet
+	void flush();
+};
+
+SpriteSheetWriter::SpriteSheetWriter(ImageWriterPool& writers, const String& prefix, int columns, int rows)
+	: writers(writers), prefix(prefix), columns(columns), rows(rows)
+	, cell_width(0), cell_height(0), count(0), sheet_count(0)
+{}
+
+void SpriteSheetWriter::add(const Image& img, const String& name) {
+	if (sheet.Ok() && (count >= columns * rows || img.GetWidth() != cell_width || img.GetHeight() != cell_height)) {
+		flush();
+	}
+	if (!sheet.Ok()) {
+		cell_width  = img.GetWidth();
+		cell_height = img.GetHeight();
+		sheet.Create(columns * cell_width, rows * cell_height, false);
+		memset(sheet.GetData(), 255, 3 * sheet.GetWidth() * sheet.GetHeight()); // white
+	}
+	int x = (count % columns) * cell_width;
+	int y = (count / columns) * cell_height;
+	sheet.Paste(img, x, y);
+	if (count > 0) card_index += _(",");
+	card_index += _("\n\t\t\t\t{\"name\": ") + json_string(name)
+	            + String::Format(_(", \"x\": %d, \"y\": %d, \"width\": %d, \"height\": %d}"), x, y, cell_width, cell_height);
+	++count;
+}
+
+void SpriteSheetWriter::flush() {
+	if (!sheet.Ok()) return;
+	// leave out the unused part of a sheet that is not full
+	int used_columns = min(count, columns);
+	int used_rows    = (count + columns - 1) / columns;
+	if (used_columns < columns || used_rows < rows) {
+		sheet = sheet.GetSubImage(wxRect(0, 0, used_columns * cell_width, used_rows * cell_height));
+	}
+	String name = String::Format(_("sheet%d.png"), ++sheet_count);
+	if (sheet_count > 1) index += _(",");
+	index += _("\n\t\t{\"file\": ") + json_string(name)
+	       + String::Format(_(", \"width\": %d, \"height\": %d, \"cards\": ["), sheet.GetWidth(), sheet.GetHeight())
+	       + card_index + _("\n\t\t\t]}");
+	writers.write(sheet, prefix + name); // sheet is empty afterwards
+	card_index.clear();
+	count = 0;
+}
+
+String SpriteSheetWriter::finish() {
+	flush();
+	return _("{\n\t\"sheets\": [") + index + _("\n\t]\n}\n");
+}
+
 // ----------------------------------------------------------------------------- : Multiple card export
 
+ExportImagesOptions::ExportImagesOptions()
+	: conflicts(CONFLICT_NUMBER_OVERWRITE), incremental(false), jobs(0)
+	, sheet_columns(0), sheet_rows(0), progress(nullptr)
+{}
 
 void export_images(const SetP& set, const vector<CardP>& cards,
-                   const String& path, const String& filename_template, FilenameConflicts conflicts)
+                   const String& path, const String& filename_template, const ExportImagesOptions& options)
 {
 	wxBusyCursor busy;
 	// Script
 	ScriptP filename_script = parse(filename_template, nullptr, true);
 	// Path
 	wxFileName fn(path);
+	// Output
+	bool to_archive  = !options.archive.empty();
+	bool to_sheets   = options.sheet_columns > 0 && options.sheet_rows > 0;
+	bool incremental = options.incremental && !to_archive && !to_sheets;
+	// existing files only matter when each card is written to the directory
+	FilenameConflicts conflicts = to_archive || to_sheets ? CONFLICT_NUMBER_OVERWRITE : options.conflicts;
+	String prefix = to_archive ? String() : fn.GetPathWithSep();
+	int writer_threads = options.jobs > 0 ? options.jobs : parallel_thread_count();
+	PngOptions png = options.png;
+	if (png.threads <= 0 && !to_sheets) {
+		// the writers already encode images in parallel, don't start more threads than there are processors
+		png.threads = max(1, parallel_thread_count() / writer_threads);
+	}
+	FileImageTarget files(png);
+	scoped_ptr<ZipImageTarget> archive;
+	if (to_archive) archive.reset(new ZipImageTarget(options.archive, png));
+	ImageWriterTarget& target = archive ? static_cast<ImageWriterTarget&>(*archive) : files;
+	// Previous export
+	ExportManifest manifest;
+	if (incremental) manifest.read(fn.GetPath());
+	vector<String> written; // files changed in this export
+	// Writers
+	ImageWriterPool writers(target, writer_threads);
+	scoped_ptr<SpriteSheetWriter> sheets;
+	if (to_sheets) sheets.reset(new SpriteSheetWriter(writers, prefix, options.sheet_columns, options.sheet_rows));
+	CardBitmapExporter exporter(set);
 	// Export
 	std::set<String> used; // for CONFLICT_NUMBER_OVERWRITE
-	FOR_EACH_CONST(card, cards) {
-		// filename for this card
-		Context& ctx = set->getContext(card);
-		String filename = clean_filename(untag(ctx.eval(*filename_script)->toString()));
-		if (!filename) continue; // no filename -> no saving
-		// full path
-		fn.SetFullName(filename);
-		// does the file exist?
-		if (!resolve_filename_conflicts(fn, conflicts, used)) continue;
-		// write image
-		filename = fn.GetFullPath();
-		used.insert(filename);
-		export_image(set, card, filename);
+	size_t done = 0;
+	map<CardP,size_t> positions; // position of each card in the set, for the fingerprints
+	if (incremental) {
+		for (size_t i = 0 ; i < set->cards.size() ; ++i) positions[set->cards[i]] = i;
+	}
+	try {
+		FOR_EACH_CONST(card, cards) {
+			if (options.progress) options.progress->onProgress(done++, cards.size());
+			// filename for this card
+			Context& ctx = set->getContext(card);
+			String filename = clean_filename(untag(ctx.eval(*filename_script)->toString()));
+			if (!filename) continue; // no filename -> no saving
+			// full path
+			fn.SetFullName(filename);
+			// does the file exist?
+			if (!resolve_filename_conflicts(fn, conflicts, used)) continue;
+			filename = fn.GetFullPath();
+			used.insert(filename);
+			// has the card changed since the last export?
+			if (incremental) {
+				String fingerprint = card_fingerprint(*set, card, positions[card]);
+				String name = fn.GetFullName();
+				map<String,String>::const_iterator old = manifest.fingerprints.find(name);
+				if (!fingerprint.empty() && old != manifest.fingerprints.end() && old->second == fingerprint && wxFileExists(filename)) {
+					continue; // still up to date
+				}
+				if (fingerprint.empty()) {
+					manifest.fingerprints.erase(name);
+				} else {
+					manifest.fingerprints[name] = fingerprint;
+					written.push_back(name);
+				}
+			}
+			// draw the image here, encode and write it in the background
+			Image img = exporter.exportImage(card);
+			if (sheets) {
+				sheets->add(img, fn.GetFullName());
+			} else {
+				writers.write(img, prefix + fn.GetFullName());
+			}
+		}
+		String index;
+		if (sheets) index = sheets->finish();
+		writers.finish();
+		if (sheets && !target.saveText(prefix + _("sheets.json"), index)) {
+			throw Error(_("Unable to write ") + prefix + _("sheets.json"));
+		}
+		if (archive) archive->close();
+	} catch (...) {
+		if (incremental) {
+			// we don't know which of the written files are complete, so forget them
+			FOR_EACH(name, written) manifest.fingerprints.erase(name);
+			manifest.write(fn.GetPath());
+		}
+		throw;
 	}
+	if (incremental) manifest.write(fn.GetPath());
+	if (options.progress) options.progress->onProgress(cards.size(), cards.size());
 }
@@ -0,0 +1,202 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <data/format/image_writer.hpp>
+#include <util/error.hpp>
+#include <wx/filename.h>
+#include <wx/wfstream.h>
+
+DECLARE_TYPEOF_COLLECTION(String);
+
+// ----------------------------------------------------------------------------- : ImageWriterTarget
+
+bool ImageWriterTarget::encode(const Image& img, const String& name, wxOutputStream& out, const PngOptions& png) {
+	String ext = wxFileName(name).GetExt().Lower();
+	if (ext == _("png")) return write_png(img, out, png);
+	wxImageHandler* handler = wxImage::FindHandler(ext, wxBITMAP_TYPE_ANY);
+	return handler && img.SaveFile(out, handler->GetType());
+}
+
+bool FileImageTarget::save(const Image& img, const String& name, const PngOptions& png) {
+	wxFileOutputStream stream(name);
+	return stream.Ok() && encode(img, name, stream, png) && stream.Close();
+}
+
+bool FileImageTarget::saveText(const String& name, const String& text) {
+	wxFileOutputStream stream(name);
+	if (!stream.Ok()) return false;
+	size_t size;
+	wxCharBuffer utf8 = encodeText(text, size);
+	stream.Write(utf8.data(), size);
+	return stream.IsOk();
+}
+
+wxCharBuffer ImageWriterTarget::encodeText(const String& text, size_t& size_out) {
+	wxCharBuffer utf8 = text.mb_str(wxConvUTF8);
+	#if wxVERSION_NUMBER >= 2900
+		size_out = utf8.length();
+	#else
+		size_out = strlen(utf8.data()); // wx 2.8 stops converting at a NUL character anyway
+	#endif
+	return utf8;
+}
+
+// ----------------------------------------------------------------------------- : ImageWriterPool
+
+/// A copy of a string that doesn't share its data with the original
+String unshared_copy(const String& str) {
+	return String(str.c_str(), str.size());
+}
+
+class ImageWriterPool::WriterThread : public wxThread {
+  public:
+	WriterThread(ImageWriterPool& pool) : wxThread(wxTHREAD_JOINABLE), pool(pool) {}
+	virtual ExitCode Entry() {
+		Job job;
+		while (pool.next(job)) {
+			bool ok = pool.run(job);
+			pool.finished(job.filename, ok);
+			// we are the only owner of the job, so it can be freed without the lock
+			job = Job();
+		}
+		return 0;
+	}
+  private:
+	ImageWriterPool& pool;
+};
+
+ImageWriterPool::ImageWriterPool(ImageWriterTarget& target, int thread_count)
+	: target(target), changed(mutex), max_jobs(2 * max(1, thread_count)), done(false)
+{
+	for (int i = 0 ; i < thread_count ; ++i) {
+		wxThread* thread = new WriterThread(*this);
+		if (thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR) {
+			threads.push_back(thread);
+		} else {
+			delete thread;
+		}
+	}
+}
+
+ImageWriterPool::~ImageWriterPool() {
+	stop();
+}
+
+void ImageWriterPool::write(Image& img, const String& filename) {
+	write(img, filename, target.pngOptions());
+}
+
+void ImageWriterPool::write(Image& img, const String& filename, const PngOptions& png) {
+	Job job;
+	job.image    = img;
+	job.filename = unshared_copy(filename);
+	job.png      = png;
+	img = Image(); // job is now the only owner
+	add(job);
+}
+
+void ImageWriterPool::write(const GeneratedImageP& img, const GeneratedImage::Options& options, const String& filename, const PngOptions& png) {
+	Job job;
+	job.generator = img;
+	job.options   = options;
+	job.filename  = unshared_copy(filename);
+	job.png       = png;
+	add(job);
+}
+
+void ImageWriterPool::writeText(const String& text, const String& filename) {
+	Job job;
+	job.text     = unshared_copy(text);
+	job.is_text  = true;
+	job.filename = unshared_copy(filename);
+	add(job);
+}
+
+void ImageWriterPool::add(Job& job) {
+	if (threads.empty()) {
+		// no threads, save it ourselves
+		if (!run(job)) failed.push_back(job.filename);
+		job = Job();
+		return;
+	}
+	wxMutexLocker lock(mutex);
+	while (jobs.size() >= max_jobs) changed.Wait();
+	// a newer version of the same file replaces one that is still waiting
+	for (std::deque<Job>::iterator it = jobs.begin() ; it != jobs.end() ; ) {
+		if (it->filename == job.filename) {
+			it = jobs.erase(it);
+		} else {
+			++it;
+		}
+	}
+	jobs.push_back(job);
+	job = Job(); // release our references while holding the lock
+	changed.Broadcast();
+}
+
+bool ImageWriterPool::run(Job& job) {
+	if (job.is_text) {
+		return target.saveText(job.filename, job.text);
+	}
+	if (job.generator) {
+		try {
+			job.image = conform_image(job.generator->generate(job.options), job.options);
+		} catch (const Error&) {
+			return false;
+		}
+	}
+	return job.image.Ok() && target.save(job.image, job.filename, job.png);
+}
+
+bool ImageWriterPool::next(Job& job_out) {
+	wxMutexLocker lock(mutex);
+	while (true) {
+		// the oldest job for a file that no other thread is writing
+		for (std::deque<Job>::iterator it = jobs.begin() ; it != jobs.end() ; ++it) {
+			if (running.find(it->filename) == running.end()) {
+				job_out = *it;
+				jobs.erase(it);
+				running.insert(unshared_copy(job_out.filename));
+				changed.Broadcast();
+				return true;
+			}
+		}
+		if (jobs.empty() && done) return false;
+		changed.Wait();
+	}
+}
+
+void ImageWriterPool::finished(const String& filename, bool ok) {
+	wxMutexLocker lock(mutex);
+	running.erase(filename);
+	if (!ok) failed.push_back(unshared_copy(filename));
+	changed.Broadcast();
+}
+
+void ImageWriterPool::stop() {
+	{
+		wxMutexLocker lock(mutex);
+		done = true;
+		changed.Broadcast();
+	}
+	for (size_t i = 0 ; i < threads.size() ; ++i) {
+		threads[i]->Wait();
+		delete threads[i];
+	}
+	threads.clear();
+}
+
+void ImageWriterPool::finish() {
+	stop();
+	if (!failed.empty()) {
+		String message = _("Unable to write file(s):");
+		FOR_EACH(filename, failed) message += _("\n") + filename;
+		throw Error(message);
+	}
+}
@@ -0,0 +1,124 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_DATA_FORMAT_IMAGE_WRITER
+#define HEADER_DATA_FORMAT_IMAGE_WRITER
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/png_encoder.hpp>
+#include <gfx/generated_image.hpp>
+#include <wx/thread.h>
+#include <deque>
+
+// ----------------------------------------------------------------------------- : ImageWriterTarget
+
+/// Where images are written to by an ImageWriterPool
+class ImageWriterTarget {
+  public:
+	ImageWriterTarget(const PngOptions& png) : png(png) {}
+	virtual ~ImageWriterTarget() {}
+	/// Save an image under the given name, the file type is determined from the extension
+	/** PNG images are written with the given options.
+	 *  Can be called from multiple threads at once. Returns false on failure. */
+	virtual bool save(const Image& img, const String& name, const PngOptions& png) = 0;
+	/// Save a text file in UTF-8
+	virtual bool saveText(const String& name, const String& text) = 0;
+	/// The options for PNG images, unless other options are given for an image
+	inline const PngOptions& pngOptions() const { return png; }
+  protected:
+	/// Encode an image in the file type given by the extension of name
+	/** PNG images are written with our own encoder, other types with the wxImage handlers */
+	static bool encode(const Image& img, const String& name, wxOutputStream& out, const PngOptions& png);
+	/// Encode text in UTF-8, the length in bytes is stored in size_out
+	static wxCharBuffer encodeText(const String& text, size_t& size_out);
+  private:
+	PngOptions png;
+};
+
+/// Write images as files, names are full paths
+class FileImageTarget : public ImageWriterTarget {
+  public:
+	FileImageTarget(const PngOptions& png) : ImageWriterTarget(png) {}
+	virtual bool save(const Image& img, const String& name, const PngOptions& png);
+	virtual bool saveText(const String& name, const String& text);
+};
+
+// ----------------------------------------------------------------------------- : ImageWriterPool
+
+/// Background threads that encode and save images, so that the next card can be drawn in the meantime
+/** Drawing has to happen on the main thread, since wx DCs, fonts and the script
+ *  contexts are not thread safe. Saving a wxImage only touches the image itself.
+ *
+ *  Files are written in the order in which they are queued: when a file is queued again
+ *  before the previous version was written, the older job is dropped, and a file is never
+ *  written by two threads at once.
+ *
+ *  wxImage and wxString use a reference count that is not thread safe, so all copies of a
+ *  queued image are made and destroyed while holding the mutex, strings are copied in full,
+ *  and the writer threads are the only owners of the job while working on it.
+ */
+class ImageWriterPool {
+  public:
+	ImageWriterPool(ImageWriterTarget& target, int thread_count);
+	~ImageWriterPool();
+
+	/// Queue an image to be saved. Takes over img, it is empty afterwards.
+	/** Blocks while too many images are waiting, to bound the memory use. */
+	void write(Image& img, const String& filename);
+	/// Queue an image to be saved, PNG images are written with the given options instead of those of the target
+	void write(Image& img, const String& filename, const PngOptions& png);
+	/// Queue an image to be generated and then saved
+	/** The image must be safe to generate from another thread, see GeneratedImage::threadSafe.
+	 *  The result is conformed to the options, like GeneratedImage::generateConform,
+	 *  but it doesn't go through the generated image cache.
+	 */
+	void write(const GeneratedImageP& img, const GeneratedImage::Options& options, const String& filename, const PngOptions& png);
+	/// Queue a text file to be saved in UTF-8
+	void writeText(const String& text, const String& filename);
+	/// Wait until all files are saved, throws an error if some could not be saved
+	void finish();
+	/// The options for PNG images used by write(img, filename)
+	inline const PngOptions& pngOptions() const { return target.pngOptions(); }
+
+  private:
+	class WriterThread;
+	ImageWriterTarget& target;
+	struct Job {
+		Job() : is_text(false) {}
+		Image                   image;
+		GeneratedImageP         generator; ///< Generate the image from this first, if set
+		GeneratedImage::Options options;
+		String                  text;
+		bool                    is_text;
+		String                  filename;
+		PngOptions              png;
+	};
+	wxMutex             mutex;    ///< Lock protecting everything below
+	wxCondition         changed;  ///< Signaled when jobs are added or removed, or when we are done
+	std::deque<Job>     jobs;     ///< Files waiting to be saved
+	size_t              max_jobs; ///< Maximum number of waiting files
+	bool                done;     ///< No more jobs will be added
+	vector<String>      failed;   ///< Files that could not be written
+	set<String>         running;  ///< Files that are being written by a thread
+	vector<wxThread*>   threads;
+
+	/// Add a job to the queue, or do it right away if there are no threads
+	/** The job's image is taken over, strings must not share their data with other strings */
+	void add(Job& job);
+	/// Generate and save the file for a job, returns false on failure
+	bool run(Job& job);
+	/// Get the next job for a file that is not being written already, returns false if there are no more jobs
+	bool next(Job& job_out);
+	/// Record that a thread is done with a file
+	void finished(const String& filename, bool ok);
+	/// Stop the threads after the remaining jobs are done
+	void stop();
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
@@ -19,6 +19,7 @@
 #include <util/io/reader.hpp>
 #include <util/io/writer.hpp>
 #include <util/delayed_index_maps.hpp>
+#include <gfx/generated_image.hpp>
 #include <wx/filename.h>
 #include <wx/wfstream.h>
 #include <wx/stdpaths.h>
@@ -173,6 +174,7 @@ Settings::Settings()
 	, symbol_grid_size     (30)
 	, symbol_grid          (true)
 	, symbol_grid_snap     (false)
+	, image_cache_size     (64)
 	, print_layout         (LAYOUT_NO_SPACE)
 	#if USE_OLD_STYLE_UPDATE_CHECKER
 	, updates_url          (_("http://magicseteditor.sourceforge.net/updates"))
@@ -258,6 +260,7 @@ IMPLEMENT_REFLECTION_NO_SCRIPT(Settings) {
 	REFLECT(symbol_grid_size);
 	REFLECT(symbol_grid);
 	REFLECT(symbol_grid_snap);
+	REFLECT(image_cache_size);
 	REFLECT(default_game);
 	REFLECT(print_layout);
 	REFLECT(apprentice_location);
@@ -300,6 +303,7 @@ void Settings::read() {
 		Reader reader(stream, nullptr, filename);
 		reader.handle_greedy(*this);
 	}
+	set_image_file_cache_size((size_t)image_cache_size * 1024 * 1024);
 }
 
 void Settings::write() {
@@ -160,6 +160,9 @@ class Settings {
 	bool symbol_grid;
 	bool symbol_grid_snap;
 	
+	// --------------------------------------------------- : Caches
+	UInt image_cache_size; ///< Memory to use for caching decoded image files, in megabytes
+	
 	// --------------------------------------------------- : Default pacakge selections
 	String default_game;
 	
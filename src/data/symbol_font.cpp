@@ -16,6 +16,7 @@
 #include <util/window_id.hpp>
 #include <render/text/element.hpp> // fot CharInfo
 #include <script/image.hpp>
+#include <util/lru_cache.hpp>
 
 DECLARE_TYPEOF_COLLECTION(SymbolFont::DrawableSymbol);
 DECLARE_TYPEOF_COLLECTION(SymbolInFontP);
@@ -32,6 +33,7 @@ SymbolFont::SymbolFont()
 	, spacing(1,1)
 	, scale_text(false)
 	, processed_insert_symbol_menu(nullptr)
+	, split_cache(256 * 1024)
 {}
 
 SymbolFont::~SymbolFont() {
@@ -42,6 +44,11 @@ String SymbolFont::typeNameStatic() { return _("symbol-font"); }
 String SymbolFont::typeName() const { return _("symbol-font"); }
 Version SymbolFont::fileVersion() const { return file_version_symbol_font; }
 
+void SymbolFont::validate(Version v) {
+	Packaged::validate(v);
+	compileCodes();
+}
+
 SymbolFontP SymbolFont::byName(const String& name) {
 	return package_manager.open<SymbolFont>(
 		name.size() > 16 && is_substr(name, name.size() - 16, _(".mse-symbol-font"))
@@ -70,6 +77,9 @@ class SymbolInFont : public IntrusivePtrBase<SymbolInFont> {
 	/// Get a shrunk, zoomed image
 	Image getImage(Package& pkg, double size);
 	
+	/// Get a shrunk, zoomed image, with the given text drawn on top
+	Image getImageWithText(SymbolFont& font, double size, const String& text);
+	
 	/// Get a shrunk, zoomed bitmap
 	Bitmap getBitmap(Package& pkg, double size);
 	
@@ -80,7 +90,11 @@ class SymbolInFont : public IntrusivePtrBase<SymbolInFont> {
 	/** This is the size of the resulting image, it does NOT convert back to internal coordinates */
 	RealSize size(Package& pkg, double size);
 	
-	void update(Context& ctx);
+	/// Update scripted properties, returns true if the enabled status has changed
+	bool update(Context& ctx);
+	
+	/// Round a size to the bucket used for caching
+	static double quantizeSize(double size);
 	
 	String           code;			///< Code for this symbol
 	Scriptable<bool> enabled;		///< Is this symbol enabled?
@@ -97,12 +111,72 @@ class SymbolInFont : public IntrusivePtrBase<SymbolInFont> {
 	ScriptableImage  image;			///< The image for this symbol
 	double           img_size;		///< Font size used by the image
 	wxSize           actual_size;	///< Actual image size, only known after loading the image
-	/// Cached bitmaps for different sizes
-	map<double, Bitmap> bitmaps;
+	Image            source_image;	///< The unscaled image, generated on first use
+	UInt             cache_id;		///< Identifies this symbol (and its image) in the caches
+	
+	/// Make sure source_image is loaded
+	void loadSourceImage(Package& pkg);
+	/// Resample the source image to the given size
+	Image makeImage(Package& pkg, double size);
+	/// Draw text on top of the image of this symbol
+	Image drawText(SymbolFont& font, double size, const String& text);
 	
 	DECLARE_REFLECTION();
 };
 
+// ----------------------------------------------------------------------------- : SymbolInFont : image cache
+
+// The text viewer asks for symbols at many slightly different sizes while shrinking text to fit.
+// Rendered symbols are cached by size, rounded to a quarter pixel, in caches with a memory budget.
+
+/// Key for the symbol image caches
+struct SymbolImageKey {
+	SymbolImageKey(UInt cache_id, double size, const String& text)
+		: cache_id(cache_id), size_bucket((int)(size * 4 + 0.5)), text(text)
+	{}
+	UInt   cache_id;	///< Symbol and version of its image
+	int    size_bucket;	///< Size in quarter pixels
+	String text;		///< Text drawn on top of the symbol, if any
+	
+	bool operator < (const SymbolImageKey& that) const {
+		if (cache_id    != that.cache_id)    return cache_id    < that.cache_id;
+		if (size_bucket != that.size_bucket) return size_bucket < that.size_bucket;
+		return text < that.text;
+	}
+};
+
+LruCache<SymbolImageKey,Bitmap> symbol_bitmap_cache(16 * 1024 * 1024);
+LruCache<SymbolImageKey,Image>  symbol_image_cache ( 4 * 1024 * 1024);
+
+/// Approximate memory use of an image, for the cache budget
+inline size_t image_cost(int w, int h) {
+	return 4 * w * h + sizeof(SymbolImageKey);
+}
+
+/// Each SymbolInFont gets a new id whenever its image changes, so old cache entries are never used again
+AtomicInt symbol_cache_id_counter(0);
+inline UInt next_symbol_cache_id() {
+	return ++symbol_cache_id_counter;
+}
+
+LruCacheStats SymbolFont::imageCacheStats() {
+	LruCacheStats bmp = symbol_bitmap_cache.stats(), img = symbol_image_cache.stats();
+	bmp.hits      += img.hits;
+	bmp.misses    += img.misses;
+	bmp.evictions += img.evictions;
+	bmp.entries   += img.entries;
+	bmp.cost      += img.cost;
+	bmp.max_cost  += img.max_cost;
+	return bmp;
+}
+
+void SymbolFont::clearImageCaches() {
+	symbol_bitmap_cache.clear();
+	symbol_image_cache.clear();
+}
+
+// ----------------------------------------------------------------------------- : SymbolInFont
+
 SymbolInFont::SymbolInFont()
 	: enabled(true)
 	, regex(false)
@@ -111,35 +185,67 @@ SymbolInFont::SymbolInFont()
 	, text_margin_left(0), text_margin_right(0)
 	, text_margin_top(0),  text_margin_bottom(0)
 	, actual_size(0,0)
+	, cache_id(next_symbol_cache_id())
 {
 	assert(symbol_font_for_reading());
 	img_size = symbol_font_for_reading()->img_size;
 	if (img_size <= 0) img_size = 1;
 }
 
-Image SymbolInFont::getImage(Package& pkg, double size) {
-	// generate new image
+double SymbolInFont::quantizeSize(double size) {
+	return (int)(size * 4 + 0.5) / 4.0;
+}
+
+void SymbolInFont::loadSourceImage(Package& pkg) {
+	if (source_image.Ok()) return;
 	if (!image.isReady()) {
 		throw Error(_("No image specified for symbol with code '") + code + _("' in symbol font."));
 	}
-	Image img = image.generate(GeneratedImage::Options(0, 0, &pkg));
-	actual_size = wxSize(img.GetWidth(), img.GetHeight());
+	source_image = image.generate(GeneratedImage::Options(0, 0, &pkg));
+	actual_size = wxSize(source_image.GetWidth(), source_image.GetHeight());
+}
+
+Image SymbolInFont::makeImage(Package& pkg, double size) {
+	loadSourceImage(pkg);
 	// scale to match expected size
 	Image resampled_image((int) (actual_size.GetWidth()  * size / img_size),
 	                      (int) (actual_size.GetHeight() * size / img_size), false);
 	if (!resampled_image.Ok()) return Image(1,1);
-	resample(img, resampled_image);
+	resample(source_image, resampled_image);
 	return resampled_image;
 }
+
+Image SymbolInFont::getImage(Package& pkg, double size) {
+	size = quantizeSize(size);
+	SymbolImageKey key(cache_id, size, String());
+	Image img;
+	if (!symbol_image_cache.get(key, img)) {
+		img = makeImage(pkg, size);
+		symbol_image_cache.put(key, img, image_cost(img.GetWidth(), img.GetHeight()));
+	}
+	return img;
+}
 Bitmap SymbolInFont::getBitmap(Package& pkg, double size) {
-	// is this bitmap already loaded/generated?
-	Bitmap& bmp = bitmaps[size];
-	if (!bmp.Ok()) {
+	size = quantizeSize(size);
+	SymbolImageKey key(cache_id, size, String());
+	Bitmap bmp;
+	if (!symbol_bitmap_cache.get(key, bmp)) {
 		// generate image, convert to bitmap, store for later use
-		bmp = Bitmap(getImage(pkg, size));
+		bmp = Bitmap(makeImage(pkg, size));
+		symbol_bitmap_cache.put(key, bmp, image_cost(bmp.GetWidth(), bmp.GetHeight()));
 	}
 	return bmp;
 }
+Image SymbolInFont::getImageWithText(SymbolFont& font, double size, const String& text) {
+	size = quantizeSize(size);
+	SymbolImageKey key(cache_id, size, text);
+	Image img;
+	if (!symbol_image_cache.get(key, img)) {
+		img = drawText(font, size, text);
+		symbol_image_cache.put(key, img, image_cost(img.GetWidth(), img.GetHeight()));
+	}
+	return img;
+}
 Bitmap SymbolInFont::getBitmap(Package& pkg, wxSize size) {
 	// generate new bitmap
 	if (!image.isReady()) {
@@ -151,24 +257,32 @@ Bitmap SymbolInFont::getBitmap(Package& pkg, wxSize size) {
 RealSize SymbolInFont::size(Package& pkg, double size) {
 	if (actual_size.GetWidth() == 0) {
 		// we don't know what size the image will be
-		getBitmap(pkg, size);
+		loadSourceImage(pkg);
 	}
 	return wxSize(actual_size * (int) (size) / (int) (img_size));
 }
 
-void SymbolInFont::update(Context& ctx) {
+bool SymbolInFont::update(Context& ctx) {
 	if (image.update(ctx)) {
-		// image has changed, cache is no longer valid
-		bitmaps.clear();
+		// image has changed, cached images are no longer valid
+		source_image = Image();
+		cache_id = next_symbol_cache_id();
 	}
-	enabled.update(ctx);
-	if (text_font)
-		text_font->update(ctx);
+	if (text_font && text_font->update(ctx)) {
+		// text drawn on the symbol has changed
+		cache_id = next_symbol_cache_id();
+	}
+	return enabled.update(ctx);
 }
 void SymbolFont::update(Context& ctx) const {
 	// update all symbol-in-fonts
+	bool changed = false;
 	FOR_EACH_CONST(sym, symbols) {
-		sym->update(ctx);
+		changed |= sym->update(ctx);
+	}
+	if (changed) {
+		// different symbols are enabled, so text is split differently
+		split_cache.clear();
 	}
 }
 
@@ -193,73 +307,110 @@ IMPLEMENT_REFLECTION(SymbolInFont) {
 
 // ----------------------------------------------------------------------------- : SymbolFont : splitting
 
-void SymbolFont::split(const String& text, SplitSymbols& out) const {
-	// read a single symbol until we are done with the text
-	for (size_t pos = 0 ; pos < text.size() ; ) {
-		// check symbol list
-		FOR_EACH_CONST(sym, symbols) {
-			if (!sym->code.empty() && sym->enabled) {
-				if (sym->regex) {
-					if (sym->code_regex.empty()) {
-						sym->code_regex.assign(sym->code);
-					}
-					Regex::Results results;
-					if (sym->code_regex.matches(results,text.begin() + pos, text.end())
-							&& results.position() == 0 && results.length() > 0) { //Matches the regex
-						if (sym->draw_text >= 0 && sym->draw_text < (int)results.size()) {
-							out.push_back(DrawableSymbol(
-											results.str(),
-											results.str(sym->draw_text),
-											*sym));
-						} else {
-							out.push_back(DrawableSymbol(
-											results.str(),
-											_(""),
-											*sym));
-						}
-						pos += results.length();
-						goto next_symbol;
-					}
+void SymbolFont::compileCodes() const {
+	code_trie.clear();
+	regex_symbols.clear();
+	code_trie.push_back(CodeTrieNode()); // root
+	for (size_t i = 0 ; i < symbols.size() ; ++i) {
+		SymbolInFont& sym = *symbols[i];
+		if (sym.code.empty()) continue;
+		if (sym.regex) {
+			if (sym.code_regex.empty()) {
+				sym.code_regex.assign(sym.code);
+			}
+			regex_symbols.push_back(i);
+		} else {
+			// walk down the trie, adding nodes as needed
+			size_t node = 0;
+			FOR_EACH_CONST(c, sym.code) {
+				map<Char,size_t>::const_iterator it = code_trie[node].children.find(c);
+				if (it != code_trie[node].children.end()) {
+					node = it->second;
 				} else {
-					if (is_substr(text, pos, sym->code)) {
-						out.push_back(DrawableSymbol(sym->code, sym->draw_text >= 0 ? sym->code : _(""), *sym));
-						pos += sym->code.size();
-						goto next_symbol; // continue two levels
-					}
+					size_t child = code_trie.size();
+					code_trie[node].children.insert(make_pair(c, child));
+					code_trie.push_back(CodeTrieNode());
+					node = child;
 				}
 			}
+			code_trie[node].symbols.push_back(i);
 		}
-		// unknown code, draw single character as text
-		//out.push_back(DrawableSymbol(text.substr(pos, 1), _(""), defaultSymbol()));
-		pos += 1;
-next_symbol:;
 	}
 }
 
-size_t SymbolFont::recognizePrefix(const String& text, size_t start) const {
-	size_t pos;
-	for (pos = start ; pos < text.size() ; ) {
-		// check symbol list
-		FOR_EACH_CONST(sym, symbols) {
-			if (!sym->code.empty() && sym->enabled) {
-				if (sym->regex) {
-					Regex::Results results;
-					if (!sym->code_regex.empty() && sym->code_regex.matches(results,text.begin() + pos, text.end())
-							&& results.position() == 0 && results.length() > 0) { //Matches the regex
-						pos += results.length();
-						goto next_symbol;
-					}
-				} else {
-					if (is_substr(text, pos, sym->code)) {
-						pos += sym->code.size();
-						goto next_symbol; // continue two levels
-					}
-				}
+size_t SymbolFont::matchSymbol(const String& text, size_t pos, size_t& length, Regex::Results& results) const {
+	if (code_trie.empty()) compileCodes();
+	// the first matching symbol in the list wins
+	size_t best = symbols.size();
+	// literal codes: follow the text down the trie, this finds all codes that are a prefix of the text
+	size_t node = 0;
+	for (size_t i = pos ; ; ++i) {
+		const vector<size_t>& here = code_trie[node].symbols;
+		for (size_t j = 0 ; j < here.size() && here[j] < best ; ++j) {
+			if (symbols[here[j]]->enabled) {
+				best   = here[j];
+				length = i - pos;
+				break;
 			}
 		}
-		// failed
-		break;
-next_symbol:;
+		if (i >= text.size()) break;
+		map<Char,size_t>::const_iterator it = code_trie[node].children.find(text.GetChar(i));
+		if (it == code_trie[node].children.end()) break;
+		node = it->second;
+	}
+	// regex codes, only those that come before the best literal code need to be tried
+	for (size_t j = 0 ; j < regex_symbols.size() && regex_symbols[j] < best ; ++j) {
+		const SymbolInFont& sym = *symbols[regex_symbols[j]];
+		if (sym.enabled && sym.code_regex.matchesPrefix(results, text.begin() + pos, text.end())
+		                && results.length() > 0) {
+			length = results.length();
+			return regex_symbols[j];
+		}
+	}
+	return best;
+}
+
+void SymbolFont::split(const String& text, SplitSymbols& out) const {
+	// have we split this text before?
+	SplitSymbols cached;
+	if (split_cache.get(text, cached)) {
+		out.insert(out.end(), cached.begin(), cached.end());
+		return;
+	}
+	size_t first = out.size();
+	// read a single symbol until we are done with the text
+	Regex::Results results;
+	for (size_t pos = 0 ; pos < text.size() ; ) {
+		size_t length = 0;
+		size_t i = matchSymbol(text, pos, length, results);
+		if (i < symbols.size()) {
+			SymbolInFont& sym = *symbols[i];
+			if (!sym.regex) {
+				out.push_back(DrawableSymbol(sym.code, sym.draw_text >= 0 ? sym.code : _(""), sym));
+			} else if (sym.draw_text >= 0 && sym.draw_text < (int)results.size()) {
+				out.push_back(DrawableSymbol(results.str(), results.str(sym.draw_text), sym));
+			} else {
+				out.push_back(DrawableSymbol(results.str(), _(""), sym));
+			}
+			pos += length;
+		} else {
+			// unknown code, skip the character
+			pos += 1;
+		}
+	}
+	// store for next time
+	SplitSymbols result(out.begin() + first, out.end());
+	size_t cost = sizeof(String) + 2 * sizeof(Char) * text.size() + sizeof(DrawableSymbol) * result.size();
+	split_cache.put(text, result, cost);
+}
+
+size_t SymbolFont::recognizePrefix(const String& text, size_t start) const {
+	Regex::Results results;
+	size_t pos = start;
+	while (pos < text.size()) {
+		size_t length = 0;
+		if (matchSymbol(text, pos, length, results) >= symbols.size()) break;
+		pos += length;
 	}
 	return pos - start;
 }
@@ -336,29 +487,33 @@ Image SymbolFont::getImage(double font_size, const DrawableSymbol& sym) {
 	if (!sym.symbol) return Image(1,1);
 	if (sym.draw_text.empty() || !sym.symbol->text_font) return sym.symbol->getImage(*this, font_size);
 	// with text
-	Bitmap bmp(sym.symbol->getImage(*this, font_size));
+	return sym.symbol->getImageWithText(*this, font_size, sym.draw_text);
+}
+
+Image SymbolInFont::drawText(SymbolFont& font, double font_size, const String& text) {
+	Bitmap bmp(getImage(font, font_size));
 	// memory dc to work with
 	wxMemoryDC dc;
 	dc.SelectObject(bmp);
 	RealRect sym_rect(0,0,bmp.GetWidth(),bmp.GetHeight());
 	RotatedDC rdc(dc, 0, sym_rect, 1, QUALITY_AA);
 	// subtract margins from size
-	sym_rect.x      += font_size * sym.symbol->text_margin_left;
-	sym_rect.y      += font_size * sym.symbol->text_margin_top;
-	sym_rect.width  -= font_size * (sym.symbol->text_margin_left + sym.symbol->text_margin_right);
-	sym_rect.height -= font_size * (sym.symbol->text_margin_top  + sym.symbol->text_margin_bottom);
+	sym_rect.x      += font_size * text_margin_left;
+	sym_rect.y      += font_size * text_margin_top;
+	sym_rect.width  -= font_size * (text_margin_left + text_margin_right);
+	sym_rect.height -= font_size * (text_margin_top  + text_margin_bottom);
 	// setup text, shrink it
-	double size = font_size * sym.symbol->text_font->size;
+	double size = font_size * text_font->size;
 	double stretch = 1.0;
 	RealSize ts;
 	while (true) {
-		if (size <= 0) return sym.symbol->getImage(*this, font_size); // text too small
-		rdc.SetFont(*sym.symbol->text_font, size / sym.symbol->text_font->size);
-		ts = rdc.GetTextExtent(sym.draw_text);
+		if (size <= 0) return getImage(font, font_size); // text too small
+		rdc.SetFont(*text_font, size / text_font->size);
+		ts = rdc.GetTextExtent(text);
 		if (ts.height <= sym_rect.height) {
 			if (ts.width <= sym_rect.width) {
 				break; // text fits
-			} else if (ts.width * sym.symbol->text_font->max_stretch <= sym_rect.width) {
+			} else if (ts.width * text_font->max_stretch <= sym_rect.width) {
 				stretch = sym_rect.width / ts.width;
 				ts.width = sym_rect.width; // for alignment
 				break;
@@ -368,9 +523,9 @@ Image SymbolFont::getImage(double font_size, const DrawableSymbol& sym) {
 		size -= rdc.getFontSizeStep();
 	}
 	// align text
-	RealPoint text_pos = align_in_rect(sym.symbol->text_alignment, ts, sym_rect);
+	RealPoint text_pos = align_in_rect(text_alignment, ts, sym_rect);
 	// draw text
-	rdc.DrawTextWithShadow(sym.draw_text, *sym.symbol->text_font, text_pos, font_size, stretch);
+	rdc.DrawTextWithShadow(text, *text_font, text_pos, font_size, stretch);
 	// done
 	dc.SelectObject(wxNullBitmap);
 	return bmp.ConvertToImage();
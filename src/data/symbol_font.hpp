@@ -13,6 +13,7 @@
 #include <util/alignment.hpp>
 #include <util/io/package.hpp>
 #include <data/font.hpp>
+#include <util/lru_cache.hpp>
 #include <wx/regex.h>
 
 DECLARE_POINTER_TYPE(Font);
@@ -50,6 +51,7 @@ class SymbolFont : public Packaged {
 	typedef vector<DrawableSymbol> SplitSymbols;
 		
 	/// Split a string into separate symbols for drawing and for determining their size
+	/** The result is appended to out. Results are cached per string. */
 	void split(const String& text, SplitSymbols& out) const;
 	
 	/// How many consecutive characters of the text, starting at start can be rendered with this symbol font?
@@ -68,9 +70,16 @@ class SymbolFont : public Packaged {
 	/// Get the image for a symbol
 	Image getImage(double font_size, const DrawableSymbol& symbol);
 	
+	/// Statistics on the caches of rendered symbol images, shared by all symbol fonts
+	static LruCacheStats imageCacheStats();
+	/// Forget all cached symbol images
+	/** Should be called before wx is shut down, since the cache contains bitmaps */
+	static void clearImageCaches();
+	
 	static String typeNameStatic();
 	virtual String typeName() const;
 	Version fileVersion() const;
+	virtual void validate(Version);
 	
 	/// Generate a 'insert symbol' menu.
 	/** This class owns the menu!
@@ -93,7 +102,25 @@ class SymbolFont : public Packaged {
 	friend class SymbolInFont;
 	friend class InsertSymbolMenu;
 	vector<SymbolInFontP> symbols;	///< The individual symbols
-		
+	
+	/// A node in the trie of (non-regex) symbol codes
+	struct CodeTrieNode {
+		map<Char,size_t> children;	///< Index of the child node for each next character
+		vector<size_t>   symbols;	///< Symbols with the code ending here, in order
+	};
+	mutable vector<CodeTrieNode>  code_trie;		///< Trie of the non-regex codes, code_trie[0] is the root
+	mutable vector<size_t>        regex_symbols;	///< Indices of the regex symbols, in order
+	mutable LruCache<String,SplitSymbols> split_cache;	///< Previous results of split
+	
+	/// Build the code_trie, and compile regexes
+	void compileCodes() const;
+	/// Find the first symbol that matches text at position pos
+	/** Returns the index of that symbol and sets length to the length of the match,
+	 *  or returns symbols.size() if no symbol matches.
+	 *  If the symbol is a regex symbol, then results contains the match.
+	 */
+	size_t matchSymbol(const String& text, size_t pos, size_t& length, Regex::Results& results) const;
+	
 	/// Find the default symbol
 	/** may return nullptr */
 	SymbolInFont* defaultSymbol() const;
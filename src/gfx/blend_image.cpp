@@ -9,19 +9,57 @@
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
 #include <util/error.hpp>
+#include <util/parallel.hpp>
 
 // ----------------------------------------------------------------------------- : Linear Blend
 
 // sqr(x) = x^2
 template <typename T> inline T sqr(T x) { return x * x; }
 
+/// Blend rows of img2 onto img1, with a gradient given by mult = x * xm + y * ym + d
+class LinearBlendPass : public ParallelTask {
+  public:
+	static const int fixed = 1<<16; // fixed point multiplier
+	
+	LinearBlendPass(Byte* data1, const Byte* data2, int width, int xm, int ym, int d)
+		: data1(data1), data2(data2), width(width), xm(xm), ym(ym), d(d)
+	{}
+	
+	virtual void run(int begin, int end) {
+		for (int y = begin ; y < end ; ++y) {
+			Byte*       d1 = data1 + y * width * 3;
+			const Byte* d2 = data2 + y * width * 3;
+			int row = y * ym + d;
+			for (int x = 0 ; x < width ; ++x, d1 += 3, d2 += 3) {
+				int mult = x * xm + row;
+				// most of an image is usually outside the gradient, there we don't need to compute anything
+				if (mult <= 0) continue;
+				if (mult >= fixed) {
+					d1[0] = d2[0];
+					d1[1] = d2[1];
+					d1[2] = d2[2];
+					continue;
+				}
+				d1[0] = d1[0] + mult * (d2[0] - d1[0]) / fixed;
+				d1[1] = d1[1] + mult * (d2[1] - d1[1]) / fixed;
+				d1[2] = d1[2] + mult * (d2[2] - d1[2]) / fixed;
+			}
+		}
+	}
+	
+  private:
+	Byte*       data1;
+	const Byte* data2;
+	int width, xm, ym, d;
+};
+
 void linear_blend(Image& img1, const Image& img2, double x1,double y1, double x2,double y2) {
 	int width = img1.GetWidth(), height = img1.GetHeight();
 	if (img2.GetWidth() != width || img2.GetHeight() != height) {
 		throw Error(_ERROR_("images used for blending must have the same size"));
 	}
 	
-	const int fixed = 1<<16; // fixed point multiplier
+	const int fixed = LinearBlendPass::fixed;
 	// equation:
 	//   x * xm + y * ym + d  ==  fixed * f(x,y)
 	// xm and ym are multiples of delta x/y:
@@ -42,36 +80,44 @@ void linear_blend(Image& img1, const Image& img2, double x1,double y1, double x2
 	int ym = to_int( (y2 - y1) * height * a );
 	int d  = to_int( - (x1 * width * xm + y1 * height * ym) );
 	
-	Byte *data1 = img1.GetData(), *data2 = img2.GetData();
 	// blend pixels
-	for (int y = 0 ; y < height ; ++y) {
-		for (int x = 0 ; x < width ; ++x) {
-			int mult = x * xm + y * ym + d;
-			if (mult < 0)      mult = 0;
-			if (mult > fixed)  mult = fixed;
-			data1[0] = data1[0] + mult * (data2[0] - data1[0]) / fixed;
-			data1[1] = data1[1] + mult * (data2[1] - data1[1]) / fixed;
-			data1[2] = data1[2] + mult * (data2[2] - data1[2]) / fixed;
-			data1 += 3;
-			data2 += 3;
-		}
-	}
+	LinearBlendPass pass(img1.GetData(), img2.GetData(), width, xm, ym, d);
+	parallel_for(pass, height, 1 + (1 << 16) / max(1, width));
 }
 
 // ----------------------------------------------------------------------------- : Mask Blend
 
+/// Blend rows of img2 onto img1 using a mask
+class MaskBlendPass : public ParallelTask {
+  public:
+	MaskBlendPass(Byte* data1, const Byte* data2, const Byte* dataM, int width)
+		: data1(data1), data2(data2), dataM(dataM), stride(width * 3)
+	{}
+	
+	virtual void run(int begin, int end) {
+		size_t start = (size_t)begin * stride, stop = (size_t)end * stride;
+		// for each subpixel...
+		for (size_t i = start ; i < stop ; ++i) {
+			data1[i] = div255(data1[i] * dataM[i] + data2[i] * (255 - dataM[i]));
+		}
+	}
+	
+  private:
+	Byte*       data1;
+	const Byte* data2;
+	const Byte* dataM;
+	size_t      stride;
+};
+
 void mask_blend(Image& img1, const Image& img2, const Image& mask) {
 	if (img2.GetWidth() != img1.GetWidth() || img2.GetHeight() != img1.GetHeight()
 	 || mask.GetWidth() != img1.GetWidth() || mask.GetHeight() != img1.GetHeight()) {
 		throw Error(_("Images used for blending must have the same size"));
 	}
 	
-	UInt size = img1.GetWidth() * img1.GetHeight() * 3;
-	Byte *data1 = img1.GetData(), *data2 = img2.GetData(), *dataM = mask.GetData();
-	// for each subpixel...
-	for (UInt i = 0 ; i < size ; ++i) {
-		data1[i] = (data1[i] * dataM[i] + data2[i] * (255 - dataM[i])) / 255;
-	}
+	int width = img1.GetWidth();
+	MaskBlendPass pass(img1.GetData(), img2.GetData(), mask.GetData(), width);
+	parallel_for(pass, img1.GetHeight(), 1 + (1 << 16) / max(1, width * 3));
 }
 
 // ----------------------------------------------------------------------------- : Alpha
@@ -82,7 +128,7 @@ void set_alpha(Image& img, const Image& img_alpha) {
 	Byte *im = img.GetAlpha(), *al = img_alpha_resampled.GetData();
 	size_t size = img.GetWidth() * img.GetHeight();
 	for (size_t i = 0 ; i < size ; ++i) {
-		im[i] = (im[i] * al[i*3]) / 255;
+		im[i] = div255(im[i] * al[i*3]);
 	}
 }
 
@@ -99,7 +145,7 @@ void set_alpha(Image& img, Byte* al, const wxSize& alpha_size) {
 		Byte *im = img.GetAlpha();
 		size_t size = img.GetWidth() * img.GetHeight();
 		for (size_t i = 0 ; i < size ; ++i) {
-			im[i] = (im[i] * al[i]) / 255;
+			im[i] = div255(im[i] * al[i]);
 		}
 	}
 }
@@ -113,7 +159,7 @@ void set_alpha(Image& img, double alpha) {
 		Byte *im = img.GetAlpha();
 		size_t size = img.GetWidth() * img.GetHeight();
 		for (size_t i = 0 ; i < size ; ++i) {
-			im[i] = (im[i] * b_alpha) / 255;
+			im[i] = div255(im[i] * b_alpha);
 		}
 	}
 }
@@ -96,6 +96,9 @@ inline int bot(int x) { return max(0,   x); } ///< bottom range check for color
 inline int top(int x) { return min(255, x); } ///< top    range check for color values
 inline int col(int x) { return top(bot(x)); } ///< top and bottom range check for color values
 
+/// Divide by 255 without a division, exact for 0 <= x <= 255*255
+inline int div255(int x) { return (x + 1 + (x >> 8)) >> 8; }
+
 /// Linear interpolation between colors
 Color lerp(const Color& a, const Color& b, double t);
 /// Linear interpolation between colors
@@ -129,8 +132,10 @@ Color saturate(const Color& c, double amount);
  */
 RGB recolor(RGB x, RGB cr, RGB cg, RGB cb, RGB cw);
 void recolor(Image& img, RGB cr, RGB cg, RGB cb, RGB cw);
+void recolor(RGB* pixels, size_t n, RGB cr, RGB cg, RGB cb, RGB cw);
 /// Like recolor: map green to similar black/white and blue to complementary white/black
 void recolor(Image& img, RGB cr);
+void recolor(RGB* pixels, size_t n, RGB cr);
 
 /// Fills an image with the specified color
 void fill_image(Image& image, RGB color);
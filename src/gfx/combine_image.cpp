@@ -9,6 +9,7 @@
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
 #include <util/reflect.hpp>
+#include <util/parallel.hpp>
 #include <algorithm>
 
 using namespace std;
@@ -85,18 +86,84 @@ COMBINE_FUN(COMBINE_XOR,		a ^ b												)
 COMBINE_FUN(COMBINE_SHADOW,		(b * a * a) / (255 * 255)							)
 COMBINE_FUN(COMBINE_SYMMETRIC_OVERLAY,	(Combine<COMBINE_OVERLAY>::f(a,b) + Combine<COMBINE_OVERLAY>::f(b,a)) / 2 )
 
+// ----------------------------------------------------------------------------- : Lookup tables
+
+// Some combining functions need a division per channel per pixel.
+// For those it is faster to look up the result in a table with an entry for all (a,b) pairs.
+template <ImageCombine combine> struct UseCombineTable { enum { value = false }; };
+
+#define COMBINE_USE_TABLE(combine) \
+	template <> struct UseCombineTable<combine> { enum { value = true }; };
+
+COMBINE_USE_TABLE(COMBINE_COLOR_DODGE)
+COMBINE_USE_TABLE(COMBINE_COLOR_BURN)
+COMBINE_USE_TABLE(COMBINE_REFLECT)
+COMBINE_USE_TABLE(COMBINE_GLOW)
+COMBINE_USE_TABLE(COMBINE_FREEZE)
+COMBINE_USE_TABLE(COMBINE_HEAT)
+COMBINE_USE_TABLE(COMBINE_SHADOW)
+COMBINE_USE_TABLE(COMBINE_SYMMETRIC_OVERLAY)
+
+wxCriticalSection combine_table_lock;
+
+/// Table of Combine<combine>::f(a,b) at index a*256+b, the table is filled on first use
+template <ImageCombine combine>
+const Byte* combine_table() {
+	static Byte table[256 * 256];
+	static bool ready = false;
+	wxCriticalSectionLocker lock(combine_table_lock);
+	if (!ready) {
+		for (int a = 0 ; a < 256 ; ++a) {
+			for (int b = 0 ; b < 256 ; ++b) {
+				table[a * 256 + b] = Combine<combine>::f(a, b);
+			}
+		}
+		ready = true;
+	}
+	return table;
+}
+
 // ----------------------------------------------------------------------------- : Combining
 
+/// Combine rows of image b onto image a
+template <ImageCombine combine>
+class CombinePass : public ParallelTask {
+  public:
+	CombinePass(Byte* data_a, const Byte* data_b, int width)
+		: data_a(data_a), data_b(data_b), stride(width * 3)
+		, table(UseCombineTable<combine>::value ? combine_table<combine>() : nullptr)
+	{}
+	
+	virtual void run(int begin, int end) {
+		Byte*       a = data_a + begin * stride;
+		const Byte* b = data_b + begin * stride;
+		size_t size = (size_t)(end - begin) * stride;
+		if (table) {
+			for (size_t i = 0 ; i < size ; ++i) {
+				a[i] = table[a[i] * 256 + b[i]];
+			}
+		} else {
+			for (size_t i = 0 ; i < size ; ++i) {
+				a[i] = Combine<combine>::f(a[i], b[i]);
+			}
+		}
+	}
+	
+  private:
+	Byte*       data_a;
+	const Byte* data_b;
+	size_t      stride;
+	const Byte* table;
+};
+
 /// Combine image b onto image a using some combining mode.
 /// The results are stored in the image A.
 template <ImageCombine combine>
 void combine_image_do(Image& a, Image b) {
-	UInt size = a.GetWidth() * a.GetHeight() * 3;
-	Byte *dataA = a.GetData(), *dataB = b.GetData();
-	// for each pixel: apply function
-	for (UInt i = 0 ; i < size ; ++i) {
-		dataA[i] = Combine<combine>::f(dataA[i], dataB[i]);
-	}
+	int w = a.GetWidth(), h = a.GetHeight();
+	CombinePass<combine> pass(a.GetData(), b.GetData(), w);
+	// only split the work over threads for large images
+	parallel_for(pass, h, 1 + (1 << 16) / max(1, w * 3));
 }
 
 void combine_image(Image& a, const Image& b, ImageCombine combine) {
@@ -10,10 +10,13 @@
 #include <gfx/generated_image.hpp>
 #include <util/io/package.hpp>
 #include <util/error.hpp>
+#include <util/parallel.hpp>
+#include <util/hash.hpp>
 #include <data/symbol.hpp>
 #include <data/field/symbol.hpp>
 #include <render/symbol/filter.hpp>
 #include <gui/util.hpp> // load_resource_image
+#include <typeinfo>
 
 // ----------------------------------------------------------------------------- : GeneratedImage
 
@@ -24,10 +27,6 @@ GeneratedImageP GeneratedImage::toImage() const {
 	return intrusive_from_existing(const_cast<GeneratedImage*>(this));
 }
 
-Image GeneratedImage::generateConform(const Options& options) const {
-	return conform_image(generate(options),options);
-}
-
 Image conform_image(const Image& img, const GeneratedImage::Options& options) {
 	Image image = img;
 	// resize?
@@ -79,6 +78,203 @@ Image conform_image(const Image& img, const GeneratedImage::Options& options) {
 	return image;
 }
 
+// ----------------------------------------------------------------------------- : PixelFilterImage
+
+/// Applies a chain of pixel filters to the rows of an image
+/** If in and out are different images, the rows are flipped while they are copied to out */
+class PixelFilterPass : public ParallelTask {
+  public:
+	PixelFilterPass(const vector<const PixelFilterImage*>& filters, const Image& in, Image& out, bool flip_h, bool flip_v)
+		: filters(filters)
+		, w(in.GetWidth()), h(in.GetHeight())
+		, flip_h(flip_h), flip_v(flip_v)
+		, rgb_in ((RGB*)in .GetData()), alpha_in (in .HasAlpha() ? in .GetAlpha() : nullptr)
+		, rgb_out((RGB*)out.GetData()), alpha_out(out.HasAlpha() ? out.GetAlpha() : nullptr)
+	{}
+	
+	virtual void run(int begin, int end) {
+		bool in_place = rgb_in == rgb_out;
+		vector<RGB>  row      (in_place ? 0 : w);
+		vector<Byte> row_alpha(in_place || !alpha_out ? 0 : w);
+		for (int y = begin ; y < end ; ++y) {
+			RGB*  rgb = rgb_out + y * w;
+			Byte* al  = alpha_out ? alpha_out + y * w : nullptr;
+			if (!in_place) {
+				// work on a copy of the row
+				rgb = &row[0];
+				memcpy(rgb, rgb_in + y * w, w * sizeof(RGB));
+				if (alpha_out) {
+					al = &row_alpha[0];
+					if (alpha_in) memcpy(al, alpha_in + y * w, w);
+					else          memset(al, 255, w);
+				}
+			}
+			// apply filters, innermost first
+			for (size_t i = filters.size() ; i > 0 ; --i) {
+				filters[i-1]->filterPixels(rgb, al, w);
+			}
+			if (!in_place) {
+				// store the row, flipped
+				int y_out = flip_v ? h - 1 - y : y;
+				RGB*  out   = rgb_out + y_out * w;
+				Byte* out_a = alpha_out ? alpha_out + y_out * w : nullptr;
+				if (flip_h) {
+					for (int x = 0 ; x < w ; ++x) out[w - 1 - x] = rgb[x];
+					if (out_a) {
+						for (int x = 0 ; x < w ; ++x) out_a[w - 1 - x] = al[x];
+					}
+				} else {
+					memcpy(out, rgb, w * sizeof(RGB));
+					if (out_a) memcpy(out_a, al, w);
+				}
+			}
+		}
+	}
+	
+  private:
+	const vector<const PixelFilterImage*>& filters; ///< The filters, outermost first
+	int   w, h;
+	bool  flip_h, flip_v;
+	RGB*  rgb_in;  Byte* alpha_in;
+	RGB*  rgb_out; Byte* alpha_out;
+};
+
+Image PixelFilterImage::generate(const Options& opt) const {
+	// Find the chain of pixel filters below this one.
+	// Flips commute with pixel filters, and they pass the options on unchanged,
+	// so they can be part of the chain as well.
+	vector<const PixelFilterImage*> filters;
+	bool flip_h = false, flip_v = false, need_alpha = false;
+	const GeneratedImage* source = this;
+	while (true) {
+		if (const PixelFilterImage* f = dynamic_cast<const PixelFilterImage*>(source)) {
+			filters.push_back(f);
+			need_alpha = need_alpha || f->needsAlpha();
+			source = f->image.get();
+		} else if (const FlipImageHorizontal* fh = dynamic_cast<const FlipImageHorizontal*>(source)) {
+			flip_h = !flip_h;
+			source = fh->source().get();
+		} else if (const FlipImageVertical* fv = dynamic_cast<const FlipImageVertical*>(source)) {
+			flip_v = !flip_v;
+			source = fv->source().get();
+		} else {
+			break;
+		}
+	}
+	// generate the source image just once
+	Image img = source->generate(opt);
+	if (!img.Ok()) return img;
+	int min_band = 1 + (1 << 16) / img.GetWidth();
+	if (!flip_h && !flip_v) {
+		// work in place
+		if (need_alpha && !img.HasAlpha()) img.InitAlpha();
+		PixelFilterPass pass(filters, img, img, false, false);
+		parallel_for(pass, img.GetHeight(), min_band);
+		return img;
+	} else {
+		Image out(img.GetWidth(), img.GetHeight(), false);
+		if (need_alpha || img.HasAlpha()) out.InitAlpha();
+		PixelFilterPass pass(filters, img, out, flip_h, flip_v);
+		parallel_for(pass, img.GetHeight(), min_band);
+		return out;
+	}
+}
+
+// ----------------------------------------------------------------------------- : Generated image cache
+
+/// Key for the generated image cache: the structure of the image, and the options that affect the result
+struct GeneratedImageKey {
+	GeneratedImageKey(size_t hash, const GeneratedImage::Options& opt)
+		: hash(hash), width(opt.width), height(opt.height), zoom(opt.zoom), angle(opt.angle)
+		, preserve_aspect(opt.preserve_aspect), saturate(opt.saturate), package(opt.package)
+	{}
+	
+	size_t         hash;
+	int            width, height;
+	double         zoom;
+	Radians        angle;
+	PreserveAspect preserve_aspect;
+	bool           saturate;
+	Package*       package;
+	
+	bool operator < (const GeneratedImageKey& that) const {
+		if (hash            != that.hash)            return hash            < that.hash;
+		if (width           != that.width)           return width           < that.width;
+		if (height          != that.height)          return height          < that.height;
+		if (zoom            != that.zoom)            return zoom            < that.zoom;
+		if (angle           != that.angle)           return angle           < that.angle;
+		if (preserve_aspect != that.preserve_aspect) return preserve_aspect < that.preserve_aspect;
+		if (saturate        != that.saturate)        return saturate        < that.saturate;
+		return package < that.package;
+	}
+};
+
+/// A cached result of generateConform
+struct GeneratedImageResult {
+	GeneratedImageP image;         ///< The image that was generated, to detect hash collisions
+	Image           result;        ///< The generated and conformed image
+	int             width, height; ///< The options.width and options.height set by conform_image
+};
+
+/// Memory used by the data of an image
+inline size_t image_memory_size(const Image& img) {
+	size_t pixels = (size_t)img.GetWidth() * img.GetHeight();
+	return pixels * (img.HasAlpha() ? 4 : 3);
+}
+
+/// Results of generateConform, shared between all users of equal images (e.g. the same frame on all cards)
+LruCache<GeneratedImageKey, GeneratedImageResult> generated_image_cache(32 * 1024 * 1024);
+
+/// Can the image caches be used from the current thread?
+/** The reference count of wxImage is not thread safe, and the cached images are copied and
+ *  released outside the lock of the cache. So they are only shared by the main thread,
+ *  other threads (thumbnails, export writers) generate their images without the cache.
+ */
+inline bool can_use_image_cache() {
+	return wxThread::IsMain();
+}
+
+Image GeneratedImage::generateConform(const Options& options) const {
+	if (local() || !can_use_image_cache()) {
+		// images from the set are rarely shared between cards,
+		// and a new set can get the address of a closed one, so don't cache these
+		return conform_image(generate(options), options);
+	}
+	GeneratedImageKey key(hash(), options);
+	GeneratedImageResult cached;
+	if (generated_image_cache.get(key, cached) && *cached.image == *this) {
+		options.width  = cached.width;
+		options.height = cached.height;
+		return cached.result.Copy(); // the caller is allowed to modify the image
+	}
+	// generate
+	cached.image  = toImage();
+	cached.result = conform_image(generate(options), options);
+	cached.width  = options.width;
+	cached.height = options.height;
+	generated_image_cache.put(key, cached, image_memory_size(cached.result));
+	return cached.result.Copy();
+}
+
+LruCacheStats generated_image_cache_stats() {
+	return generated_image_cache.stats();
+}
+
+void clear_generated_image_cache() {
+	generated_image_cache.clear();
+}
+
+// ----------------------------------------------------------------------------- : Hashing
+
+/// Hash identifying the type of a generated image
+inline size_t hash_of_type(const GeneratedImage& image) {
+	return (size_t)typeid(image).name();
+}
+
+inline size_t hash_color(const Color& color) {
+	return ((size_t)color.Red() << 24) | ((size_t)color.Green() << 16) | ((size_t)color.Blue() << 8) | color.Alpha();
+}
+
 // ----------------------------------------------------------------------------- : BlankImage
 
 Image BlankImage::generate(const Options& opt) const {
@@ -93,6 +289,9 @@ bool BlankImage::operator == (const GeneratedImage& that) const {
 	const BlankImage* that2 = dynamic_cast<const BlankImage*>(&that);
 	return that2;
 }
+size_t BlankImage::hash() const {
+	return hash_of_type(*this);
+}
 
 // ----------------------------------------------------------------------------- : LinearBlendImage
 
@@ -111,6 +310,14 @@ bool LinearBlendImage::operator == (const GeneratedImage& that) const {
 	             && x1 == that2->x1 && y1 == that2->y1
 	             && x2 == that2->x2 && y2 == that2->y2;
 }
+size_t LinearBlendImage::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), image1->hash());
+	h = hash_combine(h, image2->hash());
+	h = hash_combine(h, hash_double(x1));
+	h = hash_combine(h, hash_double(y1));
+	h = hash_combine(h, hash_double(x2));
+	return hash_combine(h, hash_double(y2));
+}
 
 // ----------------------------------------------------------------------------- : MaskedBlendImage
 
@@ -128,6 +335,11 @@ bool MaskedBlendImage::operator == (const GeneratedImage& that) const {
 	             && *dark  == *that2->dark
 	             && *mask  == *that2->mask;
 }
+size_t MaskedBlendImage::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), light->hash());
+	h = hash_combine(h, dark->hash());
+	return hash_combine(h, mask->hash());
+}
 
 // ----------------------------------------------------------------------------- : CombineBlendImage
 
@@ -145,6 +357,11 @@ bool CombineBlendImage::operator == (const GeneratedImage& that) const {
 	             && *image2 == *that2->image2
 	             && image_combine == that2->image_combine;
 }
+size_t CombineBlendImage::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), image1->hash());
+	h = hash_combine(h, image2->hash());
+	return hash_combine(h, image_combine);
+}
 
 // ----------------------------------------------------------------------------- : SetMaskImage
 
@@ -158,17 +375,25 @@ bool SetMaskImage::operator == (const GeneratedImage& that) const {
 	return that2 && *image == *that2->image
 	             && *mask  == *that2->mask;
 }
+size_t SetMaskImage::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), image->hash());
+	return hash_combine(h, mask->hash());
+}
 
-Image SetAlphaImage::generate(const Options& opt) const {
-	Image img = image->generate(opt);
-	set_alpha(img, alpha);
-	return img;
+void SetAlphaImage::filterPixels(RGB*, Byte* al, size_t n) const {
+	Byte b_alpha = Byte(alpha * 255);
+	for (size_t i = 0 ; i < n ; ++i) {
+		al[i] = (al[i] * b_alpha) / 255;
+	}
 }
 bool SetAlphaImage::operator == (const GeneratedImage& that) const {
 	const SetAlphaImage* that2 = dynamic_cast<const SetAlphaImage*>(&that);
 	return that2 && *image == *that2->image
 	             && alpha  == that2->alpha;
 }
+size_t SetAlphaImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), image->hash()), hash_double(alpha));
+}
 
 // ----------------------------------------------------------------------------- : SetCombineImage
 
@@ -183,49 +408,53 @@ bool SetCombineImage::operator == (const GeneratedImage& that) const {
 	return that2 && *image == *that2->image
 	             && image_combine == that2->image_combine;
 }
+size_t SetCombineImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), image->hash()), image_combine);
+}
 
 // ----------------------------------------------------------------------------- : SaturateImage
 
-Image SaturateImage::generate(const Options& opt) const {
-	Image img = image->generate(opt);
-	saturate(img, amount);
-	return img;
+void SaturateImage::filterPixels(RGB* rgb, Byte*, size_t n) const {
+	saturate((Byte*)rgb, n, amount);
 }
 bool SaturateImage::operator == (const GeneratedImage& that) const {
 	const SaturateImage* that2 = dynamic_cast<const SaturateImage*>(&that);
 	return that2 && *image == *that2->image
 	             && amount == that2->amount;
 }
+size_t SaturateImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), image->hash()), hash_double(amount));
+}
 
 // ----------------------------------------------------------------------------- : InvertImage
 
-Image InvertImage::generate(const Options& opt) const {
-	Image img = image->generate(opt);
-	invert(img);
-	return img;
+void InvertImage::filterPixels(RGB* rgb, Byte*, size_t n) const {
+	invert((Byte*)rgb, n);
 }
 bool InvertImage::operator == (const GeneratedImage& that) const {
 	const InvertImage* that2 = dynamic_cast<const InvertImage*>(&that);
 	return that2 && *image == *that2->image;
 }
+size_t InvertImage::hash() const {
+	return hash_combine(hash_of_type(*this), image->hash());
+}
 
 // ----------------------------------------------------------------------------- : RecolorImage
 
-Image RecolorImage::generate(const Options& opt) const {
-	Image img = image->generate(opt);
-	recolor(img, color);
-	return img;
+void RecolorImage::filterPixels(RGB* rgb, Byte*, size_t n) const {
+	recolor(rgb, n, color);
 }
 bool RecolorImage::operator == (const GeneratedImage& that) const {
 	const RecolorImage* that2 = dynamic_cast<const RecolorImage*>(&that);
 	return that2 && *image == *that2->image
 	             && color == that2->color;
 }
+size_t RecolorImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), image->hash()), hash_color(color));
+}
 
-Image RecolorImage2::generate(const Options& opt) const {
-	Image img = image->generate(opt);
-	recolor(img, red,green,blue,white);
-	return img;
+void RecolorImage2::filterPixels(RGB* rgb, Byte*, size_t n) const {
+	recolor(rgb, n, red,green,blue,white);
 }
 bool RecolorImage2::operator == (const GeneratedImage& that) const {
 	const RecolorImage2* that2 = dynamic_cast<const RecolorImage2*>(&that);
@@ -235,26 +464,41 @@ bool RecolorImage2::operator == (const GeneratedImage& that) const {
 	             && blue == that2->blue
 	             && white == that2->white;
 }
+size_t RecolorImage2::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), image->hash());
+	h = hash_combine(h, hash_color(red));
+	h = hash_combine(h, hash_color(green));
+	h = hash_combine(h, hash_color(blue));
+	return hash_combine(h, hash_color(white));
+}
 
 // ----------------------------------------------------------------------------- : FlipImage
 
 Image FlipImageHorizontal::generate(const Options& opt) const {
 	Image img = image->generate(opt);
-	return flip_image_horizontal(img);
+	flip_image_horizontal_in_place(img);
+	return img;
 }
 bool FlipImageHorizontal::operator == (const GeneratedImage& that) const {
 	const FlipImageHorizontal* that2 = dynamic_cast<const FlipImageHorizontal*>(&that);
 	return that2 && *image == *that2->image;
 }
+size_t FlipImageHorizontal::hash() const {
+	return hash_combine(hash_of_type(*this), image->hash());
+}
 
 Image FlipImageVertical::generate(const Options& opt) const {
 	Image img = image->generate(opt);
-	return flip_image_vertical(img);
+	flip_image_vertical_in_place(img);
+	return img;
 }
 bool FlipImageVertical::operator == (const GeneratedImage& that) const {
 	const FlipImageVertical* that2 = dynamic_cast<const FlipImageVertical*>(&that);
 	return that2 && *image == *that2->image;
 }
+size_t FlipImageVertical::hash() const {
+	return hash_combine(hash_of_type(*this), image->hash());
+}
 
 Image RotateImage::generate(const Options& opt) const {
 	Image img = image->generate(opt);
@@ -265,6 +509,9 @@ bool RotateImage::operator == (const GeneratedImage& that) const {
 	return that2 && *image == *that2->image
 	             && angle == that2->angle;
 }
+size_t RotateImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), image->hash()), hash_double(angle));
+}
 
 // ----------------------------------------------------------------------------- : EnlargeImage
 
@@ -303,6 +550,9 @@ bool EnlargeImage::operator == (const GeneratedImage& that) const {
 	return that2 && *image      == *that2->image
 	             && border_size == that2->border_size;
 }
+size_t EnlargeImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), image->hash()), hash_double(border_size));
+}
 
 // ----------------------------------------------------------------------------- : CropImage
 
@@ -315,57 +565,123 @@ bool CropImage::operator == (const GeneratedImage& that) const {
 	             && width    == that2->width    && height   == that2->height
 	             && offset_x == that2->offset_x && offset_y == that2->offset_y;
 }
+size_t CropImage::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), image->hash());
+	h = hash_combine(h, hash_double(width));
+	h = hash_combine(h, hash_double(height));
+	h = hash_combine(h, hash_double(offset_x));
+	return hash_combine(h, hash_double(offset_y));
+}
 
 // ----------------------------------------------------------------------------- : DropShadowImage
 
-/// Preform a gaussian blur, from the image in of w*h bytes to out
-/** out is scaled some scaling, this is the return value */
-UInt gaussian_blur(Byte* in, UInt* out, int w, int h, double radius) {
-	// blur horizontally
-	UInt* blur_x = new UInt[w*h]; // scaled by total_x, so in [0..255*total_x]
-	memset(blur_x, 0, w*h*sizeof(UInt));
-	UInt total_x = 0;
-	{
-		double sigma = radius * w;
-		double mult = (1 << 8) / (sqrt(2 * M_PI) * sigma);
-		double sigsqr2 = 1 / (2 * sigma * sigma);
-		int range = min(w, (int)(3*sigma));
-		for (int d = -range ; d <= range ; ++d) {
-			UInt factor = (int)( mult * exp(-d * d * sigsqr2) );
-			total_x += factor;
-			if (factor > 0) {
-				int x_start = max(0, -d), x_end = min(w, w-d);
-				for (int y = 0 ; y < h ; ++y) {
-					for (int x = x_start ; x < x_end ; ++x) {
-						blur_x[x + y*w] += in[x + d + y*w] * factor;
-					}
+/// Sizes of three box filters that together approximate a gaussian blur with standard deviation sigma
+void gaussian_box_sizes(double sigma, int sizes[3]) {
+	// The variance of a box filter of size n is (n^2-1)/12, variances add up.
+	// Use boxes of two consecutive odd sizes, such that the sum is as close to sigma^2 as possible.
+	double ideal = sqrt(12 * sigma * sigma / 3 + 1);
+	int lower = max(1, (int)floor(ideal));
+	if (lower % 2 == 0) lower--;
+	int upper = lower + 2;
+	int m = to_int((12 * sigma * sigma - 3 * lower * lower - 12 * lower - 9) / (-4 * lower - 4));
+	for (int i = 0 ; i < 3 ; ++i) {
+		sizes[i] = i < m ? lower : upper;
+	}
+}
+
+/// A box blur of the rows or columns of an image, using a running sum
+/** Pixels outside the image count as 0 */
+class BoxBlurPass : public ParallelTask {
+  public:
+	BoxBlurPass(const UInt* in, UInt* out, int w, int h, int size, bool vertical)
+		: in(in), out(out), w(w), h(h), r(size / 2), vertical(vertical)
+		, inv(((wxUint64)1 << 32) / size)
+	{}
+	
+	/// Blur rows [begin..end), or for a vertical blur columns [begin..end)
+	virtual void run(int begin, int end) {
+		if (vertical) {
+			// keep a running sum for each column, and walk over the rows in order
+			vector<wxUint64> sums(end - begin, 0);
+			for (int y = 0 ; y < min(r, h) ; ++y) addRow(sums, y, begin, 1);
+			for (int y = 0 ; y < h ; ++y) {
+				if (y + r < h) addRow(sums, y + r, begin, 1);
+				UInt* o = out + y * w + begin;
+				for (size_t x = 0 ; x < sums.size() ; ++x) {
+					o[x] = scale(sums[x]);
 				}
+				if (y - r >= 0) addRow(sums, y - r, begin, -1);
 			}
-		}
-	}
-	// blur vertically
-	memset(out, 0, w*h*sizeof(UInt));
-	UInt total_y = 0;
-	{
-		double sigma = radius * h;
-		double mult = (1 << 8) / (sqrt(2 * M_PI) * sigma);
-		double sigsqr2 = 1 / (2 * sigma * sigma);
-		int range = min(h, (int)(3*sigma));
-		for (int d = -range ; d <= range ; ++d) {
-			UInt factor = (UInt)( mult * exp(-d * d * sigsqr2) );
-			total_y += factor;
-			if (factor > 0) {
-				int y_start = max(0, -d), y_end = min(h, h-d);
-				for (int y = y_start ; y < y_end ; ++y) {
-					for (int x = 0 ; x < w ; ++x) {
-						out[x + y*w] += blur_x[x + (d + y)*w] * factor;
-					}
+		} else {
+			for (int y = begin ; y < end ; ++y) {
+				const UInt* i = in  + y * w;
+				UInt*       o = out + y * w;
+				wxUint64 sum = 0;
+				for (int x = 0 ; x < min(r, w) ; ++x) sum += i[x];
+				for (int x = 0 ; x < w ; ++x) {
+					if (x + r < w) sum += i[x + r];
+					o[x] = scale(sum);
+					if (x - r >= 0) sum -= i[x - r];
 				}
 			}
 		}
 	}
-	delete[] blur_x;
-	return total_x * total_y;
+	
+  private:
+	const UInt* in;
+	UInt*       out;
+	int         w, h, r;
+	bool        vertical;
+	wxUint64    inv; ///< 2^32 / size
+	
+	/// Divide a sum by the size of the box
+	inline UInt scale(wxUint64 sum) const {
+		return (UInt)((sum * inv + ((wxUint64)1 << 31)) >> 32);
+	}
+	/// Add (sign=1) or subtract (sign=-1) a part of row y to the running sums
+	inline void addRow(vector<wxUint64>& sums, int y, int x_start, int sign) const {
+		const UInt* i = in + y * w + x_start;
+		if (sign > 0) {
+			for (size_t x = 0 ; x < sums.size() ; ++x) sums[x] += i[x];
+		} else {
+			for (size_t x = 0 ; x < sums.size() ; ++x) sums[x] -= i[x];
+		}
+	}
+};
+
+/// Preform a gaussian blur, from the image in of w*h bytes to out
+/** out is scaled some scaling, this is the return value.
+ *  The blur is approximated by three box blurs in each direction,
+ *  so the cost per pixel does not depend on the radius.
+ */
+UInt gaussian_blur(Byte* in, UInt* out, int w, int h, double radius) {
+	const UInt scaling = 1 << 8; // extra precision for the intermediate results
+	int sizes_x[3], sizes_y[3];
+	gaussian_box_sizes(radius * w, sizes_x);
+	gaussian_box_sizes(radius * h, sizes_y);
+	// Work on a buffer with a border around the image, so nothing that is blurred outside the image is lost
+	// between passes. Otherwise the edges would become too dark.
+	int bx = sizes_x[0] / 2 + sizes_x[1] / 2 + sizes_x[2] / 2;
+	int by = sizes_y[0] / 2 + sizes_y[1] / 2 + sizes_y[2] / 2;
+	int pw = w + 2 * bx, ph = h + 2 * by;
+	vector<UInt> buffer(pw * ph, 0), tmp(pw * ph);
+	for (int y = 0 ; y < h ; ++y) {
+		UInt* b = &buffer[(y + by) * pw + bx];
+		for (int x = 0 ; x < w ; ++x) {
+			b[x] = in[x + y * w] * scaling;
+		}
+	}
+	// blur, alternating between buffer and tmp
+	for (int i = 0 ; i < 3 ; ++i) {
+		BoxBlurPass pass_x(&buffer[0], &tmp[0], pw, ph, sizes_x[i], false);
+		parallel_for(pass_x, ph, 1 + (1 << 16) / pw);
+		BoxBlurPass pass_y(&tmp[0], &buffer[0], pw, ph, sizes_y[i], true);
+		parallel_for(pass_y, pw, 1 + (1 << 16) / ph);
+	}
+	for (int y = 0 ; y < h ; ++y) {
+		memcpy(out + y * w, &buffer[(y + by) * pw + bx], w * sizeof(UInt));
+	}
+	return scaling;
 }
 
 Image DropShadowImage::generate(const Options& opt) const {
@@ -411,6 +727,45 @@ bool DropShadowImage::operator == (const GeneratedImage& that) const {
 	             && shadow_alpha == that2->shadow_alpha && shadow_blur_radius == that2->shadow_blur_radius
 	             && shadow_color == that2->shadow_color;
 }
+size_t DropShadowImage::hash() const {
+	size_t h = hash_combine(hash_of_type(*this), image->hash());
+	h = hash_combine(h, hash_double(offset_x));
+	h = hash_combine(h, hash_double(offset_y));
+	h = hash_combine(h, hash_double(shadow_alpha));
+	h = hash_combine(h, hash_double(shadow_blur_radius));
+	return hash_combine(h, hash_color(shadow_color));
+}
+
+// ----------------------------------------------------------------------------- : Image file cache
+
+/// Decoded image files, by Package::fileStamp
+LruCache<String, Image> image_file_cache(64 * 1024 * 1024);
+
+LruCacheStats image_file_cache_stats() {
+	return image_file_cache.stats();
+}
+
+void set_image_file_cache_size(size_t bytes) {
+	image_file_cache.setMaxCost(bytes);
+}
+
+/// Load an image file from a package, returns an invalid image if the file can not be decoded
+/** The decoded image is cached for as long as the file doesn't change.
+ *  Only the main thread uses the cache, see can_use_image_cache.
+ */
+template <typename FileName>
+Image load_image_file(Package& package, const FileName& filename) {
+	String stamp = can_use_image_cache() ? package.fileStamp(filename) : String();
+	Image img;
+	if (!stamp.empty() && image_file_cache.get(stamp, img)) {
+		return img.Copy(); // the caller is allowed to modify the image
+	}
+	InputStreamP file = package.openIn(filename);
+	if (!img.LoadFile(*file)) return Image();
+	if (stamp.empty()) return img;
+	image_file_cache.put(stamp, img, image_memory_size(img));
+	return img.Copy();
+}
 
 // ----------------------------------------------------------------------------- : PackagedImage
 
@@ -418,9 +773,8 @@ Image PackagedImage::generate(const Options& opt) const {
 	// TODO : use opt.width and opt.height?
 	// open file from package
 	if (!opt.package) throw ScriptError(_("Can only load images in a context where an image is expected"));
-	InputStreamP file = opt.package->openIn(filename);
-	Image img;
-	if (img.LoadFile(*file)) {
+	Image img = load_image_file(*opt.package, filename);
+	if (img.Ok()) {
 		if (img.HasMask()) img.InitAlpha(); // we can't handle masks
 		return img;
 	} else {
@@ -431,6 +785,9 @@ bool PackagedImage::operator == (const GeneratedImage& that) const {
 	const PackagedImage* that2 = dynamic_cast<const PackagedImage*>(&that);
 	return that2 && filename == that2->filename;
 }
+size_t PackagedImage::hash() const {
+	return hash_combine(hash_of_type(*this), hash_string(filename));
+}
 
 // ----------------------------------------------------------------------------- : BuiltInImage
 
@@ -446,6 +803,9 @@ bool BuiltInImage::operator == (const GeneratedImage& that) const {
 	const BuiltInImage* that2 = dynamic_cast<const BuiltInImage*>(&that);
 	return that2 && name == that2->name;
 }
+size_t BuiltInImage::hash() const {
+	return hash_combine(hash_of_type(*this), hash_string(name));
+}
 
 // ----------------------------------------------------------------------------- : SymbolToImage
 
@@ -485,6 +845,9 @@ bool SymbolToImage::operator == (const GeneratedImage& that) const {
 	                 *variation == *that2->variation // custom variation
 	                );
 }
+size_t SymbolToImage::hash() const {
+	return hash_combine(hash_combine(hash_of_type(*this), is_local), filename.hash());
+}
 
 
 // ----------------------------------------------------------------------------- : ImageValueToImage
@@ -503,8 +866,7 @@ Image ImageValueToImage::generate(const Options& opt) const {
 	if (!opt.local_package) throw ScriptError(_("Can only load images in a context where an image is expected"));
 	Image image;
 	if (!filename.empty()) {
-		InputStreamP image_file = opt.local_package->openIn(filename);
-		image.LoadFile(*image_file);
+		image = load_image_file(*opt.local_package, filename);
 	}
 	if (!image.Ok()) {
 		image = Image(max(1,opt.width), max(1,opt.height));
@@ -515,6 +877,9 @@ bool ImageValueToImage::operator == (const GeneratedImage& that) const {
 	const ImageValueToImage* that2 = dynamic_cast<const ImageValueToImage*>(&that);
 	return that2 && filename == that2->filename;
 }
+size_t ImageValueToImage::hash() const {
+	return hash_combine(hash_of_type(*this), filename.hash());
+}
 
 String quote_string(String const& str);
 String ImageValueToImage::toCode() const {
@@ -11,6 +11,7 @@
 
 #include <util/prec.hpp>
 #include <util/age.hpp>
+#include <util/lru_cache.hpp>
 #include <util/io/package.hpp>
 #include <gfx/gfx.hpp>
 #include <script/value.hpp>
@@ -45,6 +46,9 @@ class GeneratedImage : public ScriptValue {
 	};
 	
 	/// Generate the image, and conform to the options
+	/** The result is shared with other users of equal images, through the generated image cache.
+	 *  Like conform_image, sets options.width and options.height to the actual size.
+	 */
 	Image generateConform(const Options&) const;
 	/// Generate the image
 	virtual Image generate(const Options&) const = 0;
@@ -53,8 +57,11 @@ class GeneratedImage : public ScriptValue {
 	/// Equality should mean that every pixel in the generated images is the same if the same options are used
 	virtual bool operator == (const GeneratedImage& that) const = 0;
 	inline  bool operator != (const GeneratedImage& that) const { return !(*this == that); }
+	/// Hash of the structure of this image, images that are equal (==) must have the same hash
+	virtual size_t hash() const = 0;
 	
 	/// Can this image be generated safely from another thread?
+	/** Images made from other images are only thread safe if all of those are. */
 	virtual bool threadSafe() const { return true; }
 	/// Is this image specific to the set (the local_package)?
 	virtual bool local() const { return false; }
@@ -70,6 +77,21 @@ class GeneratedImage : public ScriptValue {
 /// Resize an image to conform to the options
 Image conform_image(const Image&, const GeneratedImage::Options&);
 
+// ----------------------------------------------------------------------------- : Generated image cache
+
+/// Statistics on the cache of generated images used by generateConform
+LruCacheStats generated_image_cache_stats();
+/// Forget all cached generated images
+/** Should be called when packages are unloaded, since the cache refers to them by address. */
+void clear_generated_image_cache();
+
+// ----------------------------------------------------------------------------- : Image file cache
+
+/// Statistics on the cache of decoded image files, used by PackagedImage and ImageValueToImage
+LruCacheStats image_file_cache_stats();
+/// Change the memory budget for decoded image files, in bytes
+void set_image_file_cache_size(size_t bytes);
+
 // ----------------------------------------------------------------------------- : SimpleFilterImage
 
 /// Apply some filter to a single image
@@ -80,10 +102,33 @@ class SimpleFilterImage : public GeneratedImage {
 	{}
 	virtual ImageCombine combine() const { return image->combine(); }
 	virtual bool local() const { return image->local(); }
+	virtual bool threadSafe() const { return image->threadSafe(); }
+	/// The image that is filtered
+	inline const GeneratedImageP& source() const { return image; }
   protected:
 	GeneratedImageP image;
 };
 
+// ----------------------------------------------------------------------------- : PixelFilterImage
+
+/// A filter that changes each pixel independently of all others
+/** A chain of these filters (possibly with flips in between) is applied in a single pass over the image,
+ *  instead of each filter making a pass of its own.
+ */
+class PixelFilterImage : public SimpleFilterImage {
+  public:
+	inline PixelFilterImage(const GeneratedImageP& image)
+		: SimpleFilterImage(image)
+	{}
+	virtual Image generate(const Options& opt) const;
+	
+	/// Apply this filter to n pixels
+	/** alpha is nullptr if the image has no alpha channel and needsAlpha() is false */
+	virtual void filterPixels(RGB* rgb, Byte* alpha, size_t n) const = 0;
+	/// Does this filter need (and change) the alpha channel?
+	virtual bool needsAlpha() const { return false; }
+};
+
 // ----------------------------------------------------------------------------- : BlankImage
 
 /// An image generator that returns a blank image
@@ -91,6 +136,7 @@ class BlankImage : public GeneratedImage {
   public:
 	virtual Image generate(const Options&) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
 	virtual bool isBlank() const { return true; }
 	
 	// Why is this not thread safe? What is GTK smoking?
@@ -110,7 +156,9 @@ class LinearBlendImage : public GeneratedImage {
 	virtual Image generate(const Options& opt) const;
 	virtual ImageCombine combine() const;
 	virtual bool operator == (const GeneratedImage& that) const;
-	virtual bool local() const { return image1->local() && image2->local(); }
+	virtual size_t hash() const;
+	virtual bool local() const { return image1->local() || image2->local(); }
+	virtual bool threadSafe() const { return image1->threadSafe() && image2->threadSafe(); }
   private:
 	GeneratedImageP image1, image2;
 	double x1, y1, x2, y2;
@@ -127,7 +175,9 @@ class MaskedBlendImage : public GeneratedImage {
 	virtual Image generate(const Options& opt) const;
 	virtual ImageCombine combine() const;
 	virtual bool operator == (const GeneratedImage& that) const;
-	virtual bool local() const { return light->local() && dark->local() && mask->local(); }
+	virtual size_t hash() const;
+	virtual bool local() const { return light->local() || dark->local() || mask->local(); }
+	virtual bool threadSafe() const { return light->threadSafe() && dark->threadSafe() && mask->threadSafe(); }
   private:
 	GeneratedImageP light, dark, mask;
 };
@@ -143,7 +193,9 @@ class CombineBlendImage : public GeneratedImage {
 	virtual Image generate(const Options& opt) const;
 	virtual ImageCombine combine() const;
 	virtual bool operator == (const GeneratedImage& that) const;
-	virtual bool local() const { return image1->local() && image2->local(); }
+	virtual size_t hash() const;
+	virtual bool local() const { return image1->local() || image2->local(); }
+	virtual bool threadSafe() const { return image1->threadSafe() && image2->threadSafe(); }
   private:
 	GeneratedImageP image1, image2;
 	ImageCombine image_combine;
@@ -159,18 +211,23 @@ class SetMaskImage : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
+	virtual bool local() const { return image->local() || mask->local(); }
+	virtual bool threadSafe() const { return image->threadSafe() && mask->threadSafe(); }
   private:
 	GeneratedImageP mask;
 };
 
 /// Change the alpha channel of an image
-class SetAlphaImage : public SimpleFilterImage {
+class SetAlphaImage : public PixelFilterImage {
   public:
 	inline SetAlphaImage(const GeneratedImageP& image, double alpha)
-		: SimpleFilterImage(image), alpha(alpha)
+		: PixelFilterImage(image), alpha(alpha)
 	{}
-	virtual Image generate(const Options& opt) const;
+	virtual void filterPixels(RGB* rgb, Byte* alpha, size_t n) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
+	virtual bool needsAlpha() const { return true; }
   private:
 	double alpha;
 };
@@ -186,6 +243,7 @@ class SetCombineImage : public SimpleFilterImage {
 	virtual Image generate(const Options& opt) const;
 	virtual ImageCombine combine() const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	ImageCombine image_combine;
 };
@@ -193,13 +251,14 @@ class SetCombineImage : public SimpleFilterImage {
 // ----------------------------------------------------------------------------- : SaturateImage
 
 /// Saturate/desaturate an image
-class SaturateImage : public SimpleFilterImage {
+class SaturateImage : public PixelFilterImage {
   public:
 	inline SaturateImage(const GeneratedImageP& image, double amount)
-		: SimpleFilterImage(image), amount(amount)
+		: PixelFilterImage(image), amount(amount)
 	{}
-	virtual Image generate(const Options& opt) const;
+	virtual void filterPixels(RGB* rgb, Byte* alpha, size_t n) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	double amount;
 };
@@ -207,36 +266,39 @@ class SaturateImage : public SimpleFilterImage {
 // ----------------------------------------------------------------------------- : InvertImage
 
 /// Invert an image
-class InvertImage : public SimpleFilterImage {
+class InvertImage : public PixelFilterImage {
   public:
 	inline InvertImage(const GeneratedImageP& image)
-		: SimpleFilterImage(image)
+		: PixelFilterImage(image)
 	{}
-	virtual Image generate(const Options& opt) const;
+	virtual void filterPixels(RGB* rgb, Byte* alpha, size_t n) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
 };
 
 // ----------------------------------------------------------------------------- : RecolorImage
 
 /// Recolor an image
-class RecolorImage : public SimpleFilterImage {
+class RecolorImage : public PixelFilterImage {
   public:
 	inline RecolorImage(const GeneratedImageP& image, Color color)
-		: SimpleFilterImage(image), color(color)
+		: PixelFilterImage(image), color(color)
 	{}
-	virtual Image generate(const Options& opt) const;
+	virtual void filterPixels(RGB* rgb, Byte* alpha, size_t n) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	Color color;
 };
 /// Recolor an image, with custom colors
-class RecolorImage2 : public SimpleFilterImage {
+class RecolorImage2 : public PixelFilterImage {
   public:
 	inline RecolorImage2(const GeneratedImageP& image, Color red, Color green, Color blue, Color white)
-		: SimpleFilterImage(image), red(red), green(green), blue(blue), white(white)
+		: PixelFilterImage(image), red(red), green(green), blue(blue), white(white)
 	{}
-	virtual Image generate(const Options& opt) const;
+	virtual void filterPixels(RGB* rgb, Byte* alpha, size_t n) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	Color red,green,blue,white;
 };
@@ -251,6 +313,7 @@ class FlipImageHorizontal : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
 };
 
 /// Flip an image vertically
@@ -261,6 +324,7 @@ class FlipImageVertical : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
 };
 
 /// Rotate an image
@@ -271,6 +335,7 @@ class RotateImage : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	Radians angle;
 };
@@ -285,6 +350,7 @@ class EnlargeImage : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	double border_size;
 };
@@ -299,6 +365,7 @@ class CropImage : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	double width, height;
 	double offset_x, offset_y;
@@ -315,6 +382,7 @@ class DropShadowImage : public SimpleFilterImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	double offset_x, offset_y;
 	double shadow_alpha;
@@ -332,6 +400,7 @@ class PackagedImage : public GeneratedImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	String filename;
 };
@@ -346,6 +415,7 @@ class BuiltInImage : public GeneratedImage {
 	{}
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
   private:
 	String name;
 };
@@ -359,6 +429,7 @@ class SymbolToImage : public GeneratedImage {
 	~SymbolToImage();
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
 	virtual bool local() const { return is_local; }
 	
 	#ifdef __WXGTK__
@@ -383,9 +454,12 @@ class ImageValueToImage : public GeneratedImage {
 	~ImageValueToImage();
 	virtual Image generate(const Options& opt) const;
 	virtual bool operator == (const GeneratedImage& that) const;
+	virtual size_t hash() const;
 	virtual bool local() const { return true; }
 	
 	virtual String toCode() const;
+	/// The file in the local package that the image is loaded from
+	inline const LocalFileName& getFilename() const { return filename; }
   private:
 	ImageValueToImage(const ImageValueToImage&); // copy ctor
 	LocalFileName filename;
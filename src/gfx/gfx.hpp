@@ -55,6 +55,12 @@ void sharp_resample_and_clip(const Image& img_in, Image& img_out, wxRect rect, i
  */
 void draw_resampled_text(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius = 0, int repeat = 1);
 
+/// Render text like draw_resampled_text, but return the image instead of drawing it
+/** The image has an alpha channel, it should be drawn at position pos_out.
+ *  The font is taken from dc. Returns an invalid image if there is nothing to draw.
+ */
+Image resampled_text_image(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius, wxPoint& pos_out);
+
 // scaling factor to use when drawing resampled text
 extern const int text_scaling;
 
@@ -67,6 +73,10 @@ Image rotate_image(const Image& image, Radians angle);
 Image flip_image_horizontal(const Image& image);
 /// Flip an image vertically
 Image flip_image_vertical(const Image& image);
+/// Flip an image horizontally, without making a copy
+void flip_image_horizontal_in_place(Image& image);
+/// Flip an image vertically, without making a copy
+void flip_image_vertical_in_place(Image& image);
 
 // ----------------------------------------------------------------------------- : Blending
 
@@ -88,9 +98,13 @@ void mask_blend(Image& img1, const Image& img2, const Image& mask);
 
 /// Saturate an image
 void saturate(Image& image, double amount);
+/// Saturate n pixels of RGB data
+void saturate(Byte* rgb, size_t n, double amount);
 
 /// Invert the colors in an image
 void invert(Image& img);
+/// Invert n pixels of RGB data
+void invert(Byte* rgb, size_t n);
 
 // ----------------------------------------------------------------------------- : Combining
 
@@ -144,6 +158,10 @@ void set_alpha(Image& img, double alpha);
 
 /// An alpha mask is an alpha channel that can be copied to another image
 /** It is created by treating black in the source image as transparent and white (red) as opaque
+ *
+ *  Besides the alpha values, each row is stored as a list of spans of transparent, opaque and partially
+ *  transparent pixels. Masks usually consist of large uniform regions, so applying the mask and
+ *  hit testing only have to look at individual pixels in the partial spans.
  */
 class AlphaMask : public IntrusivePtrBase<AlphaMask> {
   public:
@@ -183,10 +201,27 @@ class AlphaMask : public IntrusivePtrBase<AlphaMask> {
 	inline bool isLoaded() const { return alpha; }
 	
   private:
+	/// A run of pixels in a row that are all transparent, all opaque, or all partially transparent
+	struct Span {
+		Span(int end, Byte kind) : end(end), kind(kind) {}
+		int  end;  ///< One past the last pixel of the span, it starts where the previous span in the row ends
+		Byte kind; ///< SPAN_TRANSPARENT, SPAN_OPAQUE or SPAN_PARTIAL
+	};
+	struct SpanEndAfter;
+	
 	wxSize size; ///< Size of the mask
 	Byte* alpha; ///< Data of alpha mask
+	vector<Span>   spans;     ///< Spans of all rows
+	vector<size_t> row_spans; ///< Index of the first span of each row in spans, and a final spans.size()
 	mutable int *lefts, *rights; ///< Row sizes
 	
+	/// Compute spans from alpha
+	void loadSpans();
+	/// The span containing pixel (x,y)
+	const Span& spanAt(int x, int y) const;
+	/// The first/last pixel in row y with an alpha of at least threshold, or -1 if there is none
+	int firstAtLeast(int y, Byte threshold) const;
+	int lastAtLeast (int y, Byte threshold) const;
 	/// Compute lefts and rights from alpha
 	void loadRowSizes() const;
 };
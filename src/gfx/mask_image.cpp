@@ -24,6 +24,8 @@ void AlphaMask::clear() {
 	delete[] alpha;  alpha  = nullptr;
 	delete[] lefts;  lefts  = nullptr;
 	delete[] rights; rights = nullptr;
+	spans.clear();
+	row_spans.clear();
 }
 
 void AlphaMask::load(const Image& img) {
@@ -43,12 +45,112 @@ void AlphaMask::load(const Image& img) {
 	for (size_t i = 0 ; i < n ; ++i) {
 		to[i] = from[3*i];
 	}
+	loadSpans();
 }
 
+// ----------------------------------------------------------------------------- : Spans
+
+enum SpanKind
+{	SPAN_TRANSPARENT
+,	SPAN_OPAQUE
+,	SPAN_PARTIAL
+};
+
+inline Byte span_kind(Byte alpha) {
+	return alpha == 0 ? SPAN_TRANSPARENT : alpha == 255 ? SPAN_OPAQUE : SPAN_PARTIAL;
+}
+
+void AlphaMask::loadSpans() {
+	spans.clear();
+	row_spans.resize(size.y + 1);
+	for (int y = 0 ; y < size.y ; ++y) {
+		row_spans[y] = spans.size();
+		const Byte* row = alpha + y * size.x;
+		int x = 0;
+		while (x < size.x) {
+			Byte kind = span_kind(row[x]);
+			int end = x + 1;
+			while (end < size.x && span_kind(row[end]) == kind) ++end;
+			spans.push_back(Span(end, kind));
+			x = end;
+		}
+	}
+	row_spans[size.y] = spans.size();
+}
+
+/// Compare an x coordinate to the end of a span, for binary search
+struct AlphaMask::SpanEndAfter {
+	inline bool operator () (int x, const Span& span) const { return x < span.end; }
+};
+
+const AlphaMask::Span& AlphaMask::spanAt(int x, int y) const {
+	const Span* begin = &spans[0] + row_spans[y];
+	const Span* end   = &spans[0] + row_spans[y + 1];
+	return *upper_bound(begin, end, x, SpanEndAfter());
+}
+
+int AlphaMask::firstAtLeast(int y, Byte threshold) const {
+	const Byte* row = alpha + y * size.x;
+	int x = 0;
+	for (size_t i = row_spans[y] ; i < row_spans[y + 1] ; ++i) {
+		const Span& span = spans[i];
+		if (span.kind == SPAN_OPAQUE) return x;
+		if (span.kind == SPAN_PARTIAL) {
+			for ( ; x < span.end ; ++x) {
+				if (row[x] >= threshold) return x;
+			}
+		}
+		x = span.end;
+	}
+	return -1;
+}
+
+int AlphaMask::lastAtLeast(int y, Byte threshold) const {
+	const Byte* row = alpha + y * size.x;
+	for (size_t i = row_spans[y + 1] ; i > row_spans[y] ; --i) {
+		const Span& span = spans[i - 1];
+		int start = i - 1 > row_spans[y] ? spans[i - 2].end : 0;
+		if (span.kind == SPAN_OPAQUE) return span.end - 1;
+		if (span.kind == SPAN_PARTIAL) {
+			for (int x = span.end - 1 ; x >= start ; --x) {
+				if (row[x] >= threshold) return x;
+			}
+		}
+	}
+	return -1;
+}
+
+// ----------------------------------------------------------------------------- : Using the mask
+
 
 void AlphaMask::setAlpha(Image& img) const {
 	if (!alpha) return;
-	set_alpha(img, alpha, size);
+	if (!img.HasAlpha()) {
+		// just copy the alpha channel
+		set_alpha(img, alpha, size);
+		return;
+	}
+	if (img.GetWidth() != size.x || img.GetHeight() != size.y) {
+		throw Error(_("Image must have same size as mask"));
+	}
+	// merge, only partially transparent spans need to be multiplied
+	Byte* im = img.GetAlpha();
+	for (int y = 0 ; y < size.y ; ++y) {
+		Byte*       im_row = im    + y * size.x;
+		const Byte* al_row = alpha + y * size.x;
+		int x = 0;
+		for (size_t i = row_spans[y] ; i < row_spans[y + 1] ; ++i) {
+			const Span& span = spans[i];
+			if (span.kind == SPAN_TRANSPARENT) {
+				memset(im_row + x, 0, span.end - x);
+			} else if (span.kind == SPAN_PARTIAL) {
+				for ( ; x < span.end ; ++x) {
+					im_row[x] = div255(im_row[x] * al_row[x]);
+				}
+			}
+			x = span.end;
+		}
+	}
 }
 
 void AlphaMask::setAlpha(Bitmap& bmp) const {
@@ -61,20 +163,16 @@ void AlphaMask::setAlpha(Bitmap& bmp) const {
 bool AlphaMask::isOpaque(int x, int y) const {
 	if (x < 0 || y < 0 || x >= size.x || y >= size.y) return false;
 	if (alpha) {
-		return alpha[x + y * size.x] >= 20;
+		const Span& span = spanAt(x, y);
+		return span.kind == SPAN_OPAQUE
+		   || (span.kind == SPAN_PARTIAL && alpha[x + y * size.x] >= 20);
 	} else {
 		return true;
 	}
 }
 bool AlphaMask::isOpaque(const RealPoint& p, const RealSize& resize) const {
 	if (p.x < 0 || p.y < 0 || p.x >= resize.width || p.y >= resize.height) return false;
-	if (alpha) {
-		int x = (int)(p.x * size.x / resize.width);
-		int y = (int)(p.y * size.y / resize.height);
-		return alpha[x + y * size.x] >= 20;
-	} else {
-		return true;
-	}
+	return isOpaque((int)(p.x * size.x / resize.width), (int)(p.y * size.y / resize.height));
 }
 
 /// Do the points form a (counter??)clockwise angle?
@@ -99,34 +197,30 @@ void AlphaMask::convexHull(vector<wxPoint>& points) const {
 	// Left side, top to bottom
 	int miny = size.y, maxy = -1, lastx = 0;
 	for (int y = 0 ; y < size.y ; ++y) {
-		for (int x = 0 ; x < size.x ; ++x) {
-			if (alpha[x + y * size.x] >= 20) {
-				// opaque pixel
-				miny = min(miny,y);
-				maxy = y;
-				if (y == miny) {
-					add_convex_point(points, x-1, y-1);
-				}
-				add_convex_point(points, x-1, y);
-				lastx = x;
-				break;
+		int x = firstAtLeast(y, 20);
+		if (x >= 0) {
+			// opaque pixel
+			miny = min(miny,y);
+			maxy = y;
+			if (y == miny) {
+				add_convex_point(points, x-1, y-1);
 			}
+			add_convex_point(points, x-1, y);
+			lastx = x;
 		}
 	}
 	if (maxy == -1) return; // No image
 	add_convex_point(points, lastx-1, maxy+1);
 	// Right side, bottom to top
 	for (int y = maxy ; y >= miny ; --y) {
-		for (int x = size.x - 1 ; x >= 0 ; --x) {
-			if (alpha[x + y * size.x] >= 20) {
-				// opaque pixel
-				if (y == maxy) {
-					add_convex_point(points, x+1, y+1);
-				}
-				add_convex_point(points, x+1, y);
-				lastx = x;
-				break;
+		int x = lastAtLeast(y, 20);
+		if (x >= 0) {
+			// opaque pixel
+			if (y == maxy) {
+				add_convex_point(points, x+1, y+1);
 			}
+			add_convex_point(points, x+1, y);
+			lastx = x;
 		}
 	}
 	add_convex_point(points, lastx+1, miny-1);
@@ -147,14 +241,10 @@ void AlphaMask::loadRowSizes() const {
 	rights = new int[size.y];
 	// for each row: determine left and rightmost white pixel
 	for (int y = 0 ; y < size.y ; ++y) {
-		lefts[y]  = size.x;
-		rights[y] = 0;
-		for (int x = 0 ; x < size.x ; ++x) {
-			if (alpha[y * size.x + x] >= 128) { // white enough
-				rights[y] = x;
-				if (x < lefts[y]) lefts[y] = x;
-			}
-		}
+		int left  = firstAtLeast(y, 128); // white enough
+		int right = lastAtLeast (y, 128);
+		lefts[y]  = left  >= 0 ? left  : size.x;
+		rights[y] = right >= 0 ? right : 0;
 	}
 }
 
@@ -0,0 +1,315 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/png_encoder.hpp>
+#include <util/parallel.hpp>
+#include <wx/zstream.h>
+#include <wx/mstream.h>
+
+// ----------------------------------------------------------------------------- : PngOptions
+
+PngOptions::PngOptions()
+	: compression(6), filter(PNG_FILTER_ADAPTIVE), threads(0)
+{}
+
+bool parse_png_filter(const String& name, PngFilter& filter_out) {
+	if      (name == _("none"))     filter_out = PNG_FILTER_NONE;
+	else if (name == _("sub"))      filter_out = PNG_FILTER_SUB;
+	else if (name == _("up"))       filter_out = PNG_FILTER_UP;
+	else if (name == _("average"))  filter_out = PNG_FILTER_AVERAGE;
+	else if (name == _("paeth"))    filter_out = PNG_FILTER_PAETH;
+	else if (name == _("adaptive")) filter_out = PNG_FILTER_ADAPTIVE;
+	else return false;
+	return true;
+}
+
+// ----------------------------------------------------------------------------- : Checksums
+
+/// Lookup table for the CRC-32 checksums of PNG chunks
+class Crc32Table {
+  public:
+	Crc32Table() {
+		for (UInt n = 0 ; n < 256 ; ++n) {
+			UInt c = n;
+			for (int k = 0 ; k < 8 ; ++k) {
+				c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+			}
+			table[n] = c;
+		}
+	}
+	inline UInt update(UInt crc, const Byte* data, size_t size) const {
+		for (size_t i = 0 ; i < size ; ++i) {
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		}
+		return crc;
+	}
+  private:
+	UInt table[256];
+};
+// initialized before main, so it is safe to use from multiple threads
+const Crc32Table crc32_table;
+
+const UInt ADLER_BASE = 65521;
+
+/// Update an Adler-32 checksum (as used by zlib) with more data
+UInt adler32(UInt adler, const Byte* data, size_t size) {
+	UInt a = adler & 0xFFFF, b = adler >> 16;
+	while (size > 0) {
+		size_t n = min(size, (size_t)5552); // the sums can't overflow in this many steps
+		size -= n;
+		for ( ; n > 0 ; --n) {
+			a += *data++;
+			b += a;
+		}
+		a %= ADLER_BASE;
+		b %= ADLER_BASE;
+	}
+	return (b << 16) | a;
+}
+
+/// Adler-32 checksum of two blocks of data, given the checksums of both blocks and the size of the second one
+UInt adler32_combine(UInt adler1, UInt adler2, size_t size2) {
+	UInt rem  = (UInt)(size2 % ADLER_BASE);
+	UInt sum1 = adler1 & 0xFFFF;
+	UInt sum2 = (rem * sum1) % ADLER_BASE;
+	sum1 += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+	sum2 += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+	if (sum1 >= ADLER_BASE)     sum1 -= ADLER_BASE;
+	if (sum1 >= ADLER_BASE)     sum1 -= ADLER_BASE;
+	if (sum2 >= 2 * ADLER_BASE) sum2 -= 2 * ADLER_BASE;
+	if (sum2 >= ADLER_BASE)     sum2 -= ADLER_BASE;
+	return (sum2 << 16) | sum1;
+}
+
+// ----------------------------------------------------------------------------- : Filtering
+
+/// Get a row of an image as RGB or RGBA bytes
+void png_image_row(const Image& img, int y, bool alpha, Byte* out) {
+	int width = img.GetWidth();
+	const Byte* rgb = img.GetData() + 3 * width * y;
+	if (!alpha) {
+		memcpy(out, rgb, 3 * width);
+	} else if (img.HasAlpha()) {
+		const Byte* a = img.GetAlpha() + width * y;
+		for (int x = 0 ; x < width ; ++x) {
+			out[4*x]   = rgb[3*x];
+			out[4*x+1] = rgb[3*x+1];
+			out[4*x+2] = rgb[3*x+2];
+			out[4*x+3] = a[x];
+		}
+	} else {
+		Byte mr = img.GetMaskRed(), mg = img.GetMaskGreen(), mb = img.GetMaskBlue();
+		for (int x = 0 ; x < width ; ++x) {
+			out[4*x]   = rgb[3*x];
+			out[4*x+1] = rgb[3*x+1];
+			out[4*x+2] = rgb[3*x+2];
+			out[4*x+3] = rgb[3*x] == mr && rgb[3*x+1] == mg && rgb[3*x+2] == mb ? 0 : 255;
+		}
+	}
+}
+
+inline Byte paeth_predictor(int a, int b, int c) {
+	int p = a + b - c;
+	int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return (Byte)a;
+	else if (pb <= pc)        return (Byte)b;
+	else                      return (Byte)c;
+}
+
+/// Filter a row of size bytes, with bpp bytes per pixel
+/** prev is the previous row, or nullptr for the first row of the image.
+ *  out gets the filter type followed by the filtered row.
+ */
+void png_filter_row(PngFilter filter, const Byte* row, const Byte* prev, int size, int bpp, Byte* out) {
+	*out++ = (Byte)filter;
+	switch (filter) {
+		case PNG_FILTER_SUB:
+			for (int i = 0 ; i < size ; ++i) {
+				out[i] = row[i] - (i >= bpp ? row[i-bpp] : 0);
+			}
+			break;
+		case PNG_FILTER_UP:
+			for (int i = 0 ; i < size ; ++i) {
+				out[i] = row[i] - (prev ? prev[i] : 0);
+			}
+			break;
+		case PNG_FILTER_AVERAGE:
+			for (int i = 0 ; i < size ; ++i) {
+				int left = i >= bpp ? row[i-bpp] : 0;
+				int up   = prev ? prev[i] : 0;
+				out[i] = row[i] - (Byte)((left + up) >> 1);
+			}
+			break;
+		case PNG_FILTER_PAETH:
+			for (int i = 0 ; i < size ; ++i) {
+				int left    = i >= bpp ? row[i-bpp] : 0;
+				int up      = prev ? prev[i] : 0;
+				int up_left = prev && i >= bpp ? prev[i-bpp] : 0;
+				out[i] = row[i] - paeth_predictor(left, up, up_left);
+			}
+			break;
+		default:
+			memcpy(out, row, size);
+	}
+}
+
+/// Estimate of how well a filtered row compresses, lower is better
+/** This is the heuristic recommended by the PNG specification: the sum of the bytes as signed differences */
+int png_filter_cost(const Byte* filtered, int size) {
+	int cost = 0;
+	for (int i = 0 ; i < size ; ++i) {
+		cost += abs((int)(signed char)filtered[i]);
+	}
+	return cost;
+}
+
+// ----------------------------------------------------------------------------- : PngCompressTask
+
+/// Filters and compresses blocks of rows of an image
+/** Each block is compressed separately into a raw deflate stream that ends with a full flush
+ *  (the last one with the final block), so the blocks can be concatenated.
+ */
+class PngCompressTask : public ParallelTask {
+  public:
+	PngCompressTask(const Image& img, const PngOptions& options, bool alpha, int rows_per_block)
+		: img(img), options(options), alpha(alpha), rows_per_block(rows_per_block)
+		, blocks((img.GetHeight() + rows_per_block - 1) / rows_per_block)
+	{}
+
+	struct Block {
+		Block() : adler(1), size(0), ok(false) {}
+		vector<Byte> data; ///< Compressed data
+		UInt         adler;///< Checksum of the uncompressed data
+		size_t       size; ///< Size of the uncompressed data
+		bool         ok;
+	};
+
+	virtual void run(int begin, int end);
+
+	const Image&      img;
+	const PngOptions& options;
+	bool              alpha;
+	int               rows_per_block;
+	vector<Block>     blocks;
+};
+
+void PngCompressTask::run(int begin, int end) {
+	int width  = img.GetWidth();
+	int height = img.GetHeight();
+	int bpp    = alpha ? 4 : 3;
+	int size   = width * bpp;
+	vector<Byte> row(size), prev(size), filtered(size + 1), candidate(size + 1);
+	for (int b = begin ; b < end ; ++b) {
+		Block& block = blocks[b];
+		int y_begin = b * rows_per_block;
+		int y_end   = min(height, y_begin + rows_per_block);
+		bool last   = y_end == height;
+		if (y_begin > 0) png_image_row(img, y_begin - 1, alpha, &prev[0]);
+		// compress
+		wxMemoryOutputStream buffer;
+		size_t compressed_size;
+		{
+			wxZlibOutputStream zlib(buffer, max(0, min(9, options.compression)), wxZLIB_NO_HEADER);
+			for (int y = y_begin ; y < y_end ; ++y) {
+				png_image_row(img, y, alpha, &row[0]);
+				const Byte* above = y > 0 ? &prev[0] : nullptr;
+				if (options.filter == PNG_FILTER_ADAPTIVE) {
+					int best = -1;
+					for (int f = PNG_FILTER_NONE ; f <= PNG_FILTER_PAETH ; ++f) {
+						png_filter_row((PngFilter)f, &row[0], above, size, bpp, &candidate[0]);
+						int cost = png_filter_cost(&candidate[1], size);
+						if (best < 0 || cost < best) {
+							best = cost;
+							swap(filtered, candidate);
+						}
+					}
+				} else {
+					png_filter_row(options.filter, &row[0], above, size, bpp, &filtered[0]);
+				}
+				zlib.Write(&filtered[0], size + 1);
+				block.adler = adler32(block.adler, &filtered[0], size + 1);
+				block.size += size + 1;
+				swap(row, prev);
+			}
+			if (last) {
+				block.ok = zlib.Close();
+			} else {
+				zlib.Sync(); // full flush, ends on a byte boundary
+				block.ok = zlib.IsOk();
+			}
+			compressed_size = (size_t)buffer.GetLength();
+		} // closing the stream adds a final block after the flush, which is not copied
+		const Byte* data = (const Byte*)buffer.GetOutputStreamBuffer()->GetBufferStart();
+		block.data.assign(data, data + compressed_size);
+	}
+}
+
+// ----------------------------------------------------------------------------- : Encoding
+
+inline void put_uint32(Byte* out, UInt value) {
+	out[0] = (Byte)(value >> 24);
+	out[1] = (Byte)(value >> 16);
+	out[2] = (Byte)(value >> 8);
+	out[3] = (Byte)(value);
+}
+
+/// Write a PNG chunk
+void write_png_chunk(wxOutputStream& out, const char* type, const Byte* data, size_t size) {
+	Byte length[4];
+	put_uint32(length, (UInt)size);
+	out.Write(length, 4);
+	out.Write(type, 4);
+	if (size) out.Write(data, size);
+	UInt crc = crc32_table.update(0xFFFFFFFF, (const Byte*)type, 4);
+	crc = crc32_table.update(crc, data, size) ^ 0xFFFFFFFF;
+	Byte checksum[4];
+	put_uint32(checksum, crc);
+	out.Write(checksum, 4);
+}
+
+bool write_png(const Image& img, wxOutputStream& out, const PngOptions& options) {
+	if (!img.Ok()) return false;
+	int width  = img.GetWidth();
+	int height = img.GetHeight();
+	bool alpha = img.HasAlpha() || img.HasMask();
+	// blocks of about 256KB, compressing them separately costs very little in size
+	int row_size = 1 + width * (alpha ? 4 : 3);
+	int rows_per_block = max(1, 256 * 1024 / row_size);
+	PngCompressTask task(img, options, alpha, rows_per_block);
+	parallel_for(task, (int)task.blocks.size(), 1, options.threads);
+	// signature and header
+	static const Byte signature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+	out.Write(signature, 8);
+	Byte header[13];
+	put_uint32(header,     width);
+	put_uint32(header + 4, height);
+	header[8]  = 8;             // bit depth
+	header[9]  = alpha ? 6 : 2; // color type: RGBA or RGB
+	header[10] = 0;             // compression method: deflate
+	header[11] = 0;             // filter method: adaptive
+	header[12] = 0;             // no interlacing
+	write_png_chunk(out, "IHDR", header, 13);
+	// image data: a zlib stream of the concatenated blocks, which can be split over multiple IDAT chunks
+	int level = options.compression;
+	Byte zlib_header[2] = {0x78, (Byte)((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6)};
+	zlib_header[1] += 31 - (zlib_header[0] * 256 + zlib_header[1]) % 31;
+	write_png_chunk(out, "IDAT", zlib_header, 2);
+	UInt adler = 1;
+	for (size_t i = 0 ; i < task.blocks.size() ; ++i) {
+		const PngCompressTask::Block& block = task.blocks[i];
+		if (!block.ok) return false;
+		write_png_chunk(out, "IDAT", &block.data[0], block.data.size());
+		adler = adler32_combine(adler, block.adler, block.size);
+	}
+	Byte checksum[4];
+	put_uint32(checksum, adler);
+	write_png_chunk(out, "IDAT", checksum, 4);
+	write_png_chunk(out, "IEND", nullptr, 0);
+	return out.IsOk();
+}
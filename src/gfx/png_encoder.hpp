@@ -0,0 +1,55 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_GFX_PNG_ENCODER
+#define HEADER_GFX_PNG_ENCODER
+
+/** @file gfx/png_encoder.hpp
+ *
+ *  @brief Writing PNG images, with control over speed versus size.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+// ----------------------------------------------------------------------------- : PngOptions
+
+/// Filter applied to each row of a PNG image before it is compressed
+enum PngFilter
+{	PNG_FILTER_NONE		///< Fastest, compresses photos badly
+,	PNG_FILTER_SUB
+,	PNG_FILTER_UP
+,	PNG_FILTER_AVERAGE
+,	PNG_FILTER_PAETH
+,	PNG_FILTER_ADAPTIVE	///< Pick the best filter for each row, like libpng does
+};
+
+/// How to encode PNG images
+class PngOptions {
+  public:
+	PngOptions();
+
+	int       compression; ///< zlib compression level, from 0 (no compression) to 9 (smallest)
+	PngFilter filter;
+	int       threads;     ///< Number of threads to compress with, or <= 0 for one per processor
+};
+
+/// Parse the name of a filter, returns false if the name is not known
+bool parse_png_filter(const String& name, PngFilter& filter_out);
+
+// ----------------------------------------------------------------------------- : Encoding
+
+/// Write an image in PNG format
+/** The image data is split into independent blocks of rows,
+ *  which are filtered and compressed in parallel.
+ *  Uses the alpha channel of the image, or its mask if it has no alpha channel.
+ *  Returns false if writing to the stream fails.
+ */
+bool write_png(const Image& img, wxOutputStream& out, const PngOptions& options);
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
@@ -9,15 +9,21 @@
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
 #include <util/error.hpp>
+#include <util/parallel.hpp>
 
 // ----------------------------------------------------------------------------- : Resample passes
 
+/// Type used for sums of pixel values, needs 64 bits
+typedef wxUint64 Sum;
+
 // bitshift for fixed point numbers
 //  higher is less error
-//  we will get errors if 2^shift * imagesize becomes too large
-const int shift = 32-10-8; // => max size = 1024, max alpha = 255
+//  with alpha a sum is at most 255 * 255 * 2^shift, this must fit in a Sum
+//  the amount per input pixel, length_out * 2^shift / length_in, should not become too small,
+//  otherwise rounding puts a lot of extra weight on the first pixel
+const int shift = 24;
 
-// Resample an image only in a single direction, either horizontally or vertically
+/// Resample an image only in a single direction, either horizontally or vertically
 /* Terms are based on x resampling (keeping the same number of lines):
  *  offset     = number of elements to skip at the start
  *  length     = length of a line
@@ -25,94 +31,133 @@ const int shift = 32-10-8; // => max size = 1024, max alpha = 255
  *  lines      = number of lines
  *  line_delta = number of elements between the the first pixel of two lines
  *  1 element = 3 bytes in data, 1 byte in alpha
+ *
+ * Lines are independent, so large images are done in bands of lines in parallel.
  */
-void resample_pass(const Image& img_in, Image& img_out, int offset_in, int offset_out,
-                   int length_in, int delta_in, int length_out, int delta_out,
-                   int lines, int line_delta_in, int line_delta_out)
-{
-	bool alpha = img_in.HasAlpha();
-	if (alpha && !img_out.HasAlpha()) img_out.InitAlpha();
-	int out_fact = (length_out << shift) / length_in; // how much to output for 256 input = 1 pixel
-	int out_rest = (length_out << shift) % length_in;
-	// for each line
-	for (int l = 0 ; l < lines ; ++l) {
-		Byte* in  = img_in .GetData() + 3 * (offset_in  + l * line_delta_in);
-		Byte* out = img_out.GetData() + 3 * (offset_out + l * line_delta_out);
-		UInt in_rem = out_fact + out_rest; // remaining to input from the current input pixel
-		
-		if (alpha) {
-			Byte* in_a  = img_in .GetAlpha() + (offset_in  + l * line_delta_in);
-			Byte* out_a = img_out.GetAlpha() + (offset_out + l * line_delta_out);
-			
-			for (int x = 0 ; x < length_out ; ++x) {
-				UInt out_rem = 1 << shift;
-				UInt totR = 0, totG = 0, totB = 0, totA = 0;
-				while (out_rem >= in_rem) {
-					// eat a whole input pixel
-					totR += in[0]   * in_rem * in_a[0]; // multiply by alpha
-					totG += in[1]   * in_rem * in_a[0];
-					totB += in[2]   * in_rem * in_a[0];
-					totA += in_a[0] * in_rem;
-					out_rem -= in_rem;
-					in_rem = out_fact;
-					in += 3*delta_in; in_a += delta_in;
-				}
-				if (out_rem > 0) {
-					// eat a partial input pixel
-					totR += in[0]   * out_rem * in_a[0];
-					totG += in[1]   * out_rem * in_a[0];
-					totB += in[2]   * out_rem * in_a[0];
-					totA += in_a[0] * out_rem;
-					in_rem -= out_rem;
-				}
-				// store
-				if (totA) {
-					out[0] = totR / totA;
-					out[1] = totG / totA;
-					out[2] = totB / totA;
-					out_a[0] = totA >> shift;
-				} else {
-					out[0] = out[1] = out[2] = out_a[0] = 0; // div by 0 is bad
-				}
-				out += 3*delta_out; out_a += delta_out;
-			}
-			
+class ResamplePass : public ParallelTask {
+  public:
+	ResamplePass(const Image& img_in, Image& img_out, int offset_in, int offset_out,
+	             int length_in, int delta_in, int length_out, int delta_out,
+	             int line_delta_in, int line_delta_out)
+		: length_out(length_out), delta_in(delta_in), delta_out(delta_out)
+		, line_delta_in(line_delta_in), line_delta_out(line_delta_out)
+	{
+		data_in  = img_in .GetData() + 3 * offset_in;
+		data_out = img_out.GetData() + 3 * offset_out;
+		if (img_in.HasAlpha()) {
+			if (!img_out.HasAlpha()) img_out.InitAlpha();
+			alpha_in  = img_in .GetAlpha() + offset_in;
+			alpha_out = img_out.GetAlpha() + offset_out;
 		} else {
-			// no alpha
-			for (int x = 0 ; x < length_out ; ++x) {
-				UInt out_rem = 1 << shift;
-				UInt totR = 0, totG = 0, totB = 0;
-				while (out_rem >= in_rem) {
-					// eat a whole input pixel
-					totR += in[0] * in_rem;
-					totG += in[1] * in_rem;
-					totB += in[2] * in_rem;
-					out_rem -= in_rem;
-					in_rem = out_fact;
-					in += 3*delta_in;
-				}
-				if (out_rem > 0) {
-					// eat a partial input pixel
-					totR += in[0] * out_rem;
-					totG += in[1] * out_rem;
-					totB += in[2] * out_rem;
-					in_rem -= out_rem;
-				}
-				// store
-				out[0] = totR >> shift;
-				out[1] = totG >> shift;
-				out[2] = totB >> shift;
-				out += 3*delta_out;
+			alpha_in = alpha_out = nullptr;
+		}
+		out_fact = ((Sum)length_out << shift) / length_in; // how much to output for 1 input pixel
+		out_rest = ((Sum)length_out << shift) % length_in;
+	}
+	
+	virtual void run(int begin, int end) {
+		for (int l = begin ; l < end ; ++l) {
+			if (alpha_in) {
+				lineWithAlpha(data_in  + 3 * l * line_delta_in,  alpha_in  + l * line_delta_in,
+				              data_out + 3 * l * line_delta_out, alpha_out + l * line_delta_out);
+			} else {
+				line         (data_in  + 3 * l * line_delta_in,
+				              data_out + 3 * l * line_delta_out);
 			}
 		}
 	}
+	
+  private:
+	Byte *data_in, *data_out, *alpha_in, *alpha_out;
+	int length_out, delta_in, delta_out, line_delta_in, line_delta_out;
+	Sum out_fact, out_rest;
+	
+	void lineWithAlpha(const Byte* in, const Byte* in_a, Byte* out, Byte* out_a) const {
+		const int step_in = 3 * delta_in, step_out = 3 * delta_out;
+		Sum in_rem = out_fact + out_rest; // remaining to input from the current input pixel
+		for (int x = 0 ; x < length_out ; ++x) {
+			Sum out_rem = (Sum)1 << shift;
+			Sum totR = 0, totG = 0, totB = 0, totA = 0;
+			while (out_rem >= in_rem) {
+				// eat a whole input pixel
+				Sum w = in_rem * in_a[0]; // multiply by alpha
+				totR += in[0] * w;
+				totG += in[1] * w;
+				totB += in[2] * w;
+				totA += w;
+				out_rem -= in_rem;
+				in_rem = out_fact;
+				in += step_in; in_a += delta_in;
+			}
+			if (out_rem > 0) {
+				// eat a partial input pixel
+				Sum w = out_rem * in_a[0];
+				totR += in[0] * w;
+				totG += in[1] * w;
+				totB += in[2] * w;
+				totA += w;
+				in_rem -= out_rem;
+			}
+			// store
+			if (totA) {
+				out[0] = (Byte)(totR / totA);
+				out[1] = (Byte)(totG / totA);
+				out[2] = (Byte)(totB / totA);
+				out_a[0] = (Byte)(totA >> shift);
+			} else {
+				out[0] = out[1] = out[2] = out_a[0] = 0; // div by 0 is bad
+			}
+			out += step_out; out_a += delta_out;
+		}
+	}
+	
+	void line(const Byte* in, Byte* out) const {
+		const int step_in = 3 * delta_in, step_out = 3 * delta_out;
+		Sum in_rem = out_fact + out_rest; // remaining to input from the current input pixel
+		for (int x = 0 ; x < length_out ; ++x) {
+			Sum out_rem = (Sum)1 << shift;
+			Sum totR = 0, totG = 0, totB = 0;
+			while (out_rem >= in_rem) {
+				// eat a whole input pixel
+				totR += in[0] * in_rem;
+				totG += in[1] * in_rem;
+				totB += in[2] * in_rem;
+				out_rem -= in_rem;
+				in_rem = out_fact;
+				in += step_in;
+			}
+			if (out_rem > 0) {
+				// eat a partial input pixel
+				totR += in[0] * out_rem;
+				totG += in[1] * out_rem;
+				totB += in[2] * out_rem;
+				in_rem -= out_rem;
+			}
+			// store
+			out[0] = (Byte)(totR >> shift);
+			out[1] = (Byte)(totG >> shift);
+			out[2] = (Byte)(totB >> shift);
+			out += step_out;
+		}
+	}
+};
+
+void resample_pass(const Image& img_in, Image& img_out, int offset_in, int offset_out,
+                   int length_in, int delta_in, int length_out, int delta_out,
+                   int lines, int line_delta_in, int line_delta_out)
+{
+	if (length_in <= 0 || length_out <= 0 || lines <= 0) return;
+	ResamplePass pass(img_in, img_out, offset_in, offset_out, length_in, delta_in, length_out, delta_out, line_delta_in, line_delta_out);
+	// only use multiple threads when there are enough pixels in each band to make it worth it
+	int min_band = 1 + (1 << 17) / (length_in + length_out);
+	parallel_for(pass, lines, min_band);
 }
 
 // ----------------------------------------------------------------------------- : Resample
 
 /* The algorithm first resizes in horizontally, then vertically,
  * the two passes are essentially the same:
- *  - for each row:
+ *  - for each row (rows are done in parallel for large images):
  *    - each input pixel becomes a fixed amount of output (in 1<<shift fixed point math)
  *    - for each output pixel:
  *      - _('eat') input pixels until the total is 1<<shift
@@ -136,6 +181,7 @@ Image resample(const Image& img_in, int width, int height) {
 }
 
 void resample_and_clip(const Image& img_in, Image& img_out, wxRect rect) {
+	if (rect.width <= 0 || rect.height <= 0 || img_out.GetWidth() <= 0 || img_out.GetHeight() <= 0) return;
 	// mask to alpha
 	if (img_in.HasMask() && !img_in.HasAlpha()) {
 		const_cast<Image&>(img_in).InitAlpha();
@@ -162,6 +208,7 @@ void fill_transparent(Image& img) {
 }
 
 void resample_preserve_aspect(const Image& img_in, Image& img_out) {
+	if (img_in.GetWidth() <= 0 || img_in.GetHeight() <= 0 || img_out.GetWidth() <= 0 || img_out.GetHeight() <= 0) return;
 	int rheight = img_in.GetHeight() * img_out.GetWidth()  / img_in.GetWidth();
 	int rwidth  = img_in.GetWidth()  * img_out.GetHeight() / img_in.GetHeight();
 	// actual size of output
@@ -10,6 +10,7 @@
 #include <gfx/gfx.hpp>
 #include <util/error.hpp>
 #include <gui/util.hpp> // clearDC_black
+#include <util/lru_cache.hpp>
 #if defined(__WXMSW__) && wxUSE_WXDIB
 	#include <wx/msw/dib.h>
 #endif
@@ -163,47 +164,123 @@ void blur_image_alpha(Image& img) {
 	}
 }
 
-// Draw text by first drawing it using a larger font and then downsampling it
-// optionally rotated by an angle
-void draw_resampled_text(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius, int repeat) {
-	// transparent text can be ignored
-	if (color.alpha == 0) return;
-	// enlarge slightly; some fonts are larger then the GetTextExtent tells us (especially italic fonts)
-	int w = static_cast<int>(rect.width) + 3 + 2 * blur_radius, h = static_cast<int>(rect.height) + 1 + 2 * blur_radius;
-	// determine sub-pixel position
-	int xi = static_cast<int>(rect.x) - blur_radius / text_scaling,
-	    yi = static_cast<int>(rect.y) - blur_radius / text_scaling;
-	int xsub = static_cast<int>(text_scaling * (pos.x - xi)),
-	    ysub = static_cast<int>(text_scaling * (pos.y - yi));
+// ----------------------------------------------------------------------------- : Text run cache
+
+// The same pieces of text (type lines, keywords, mana costs) are drawn over and over again.
+// Rendering them at text_scaling times the size and downsampling is expensive,
+// so we remember the resulting alpha masks. The color is only applied when drawing.
+
+/// Everything that influences the alpha mask of a piece of resampled text
+struct TextRunKey {
+	String  text;
+	String  font;        ///< Native description of the (scaled) font
+	Radians angle;
+	double  stretch;
+	int     w, h;        ///< Size of the buffer, before stretching
+	int     xsub, ysub;  ///< Sub-pixel position of the text in the buffer
+	int     blur_radius;
+	
+	bool operator < (const TextRunKey& that) const {
+		if (w           != that.w)           return w           < that.w;
+		if (h           != that.h)           return h           < that.h;
+		if (xsub        != that.xsub)        return xsub        < that.xsub;
+		if (ysub        != that.ysub)        return ysub        < that.ysub;
+		if (blur_radius != that.blur_radius) return blur_radius < that.blur_radius;
+		if (angle       != that.angle)       return angle       < that.angle;
+		if (stretch     != that.stretch)     return stretch     < that.stretch;
+		if (text        != that.text)        return text        < that.text;
+		return font < that.font;
+	}
+};
+
+/// The alpha mask of a piece of resampled text
+struct TextRunMask {
+	wxSize       size;
+	vector<Byte> alpha; ///< size.x * size.y alpha values, empty if downsampling failed
+};
+typedef shared_ptr<TextRunMask> TextRunMaskP;
+
+/// Cached alpha masks of text runs
+LruCache<TextRunKey,TextRunMaskP> text_run_cache(8 * 1024 * 1024);
+
+// Render the alpha mask for a piece of text
+TextRunMaskP render_text_run_alpha(DC& dc, const TextRunKey& key) {
 	// draw text
-	Bitmap buffer(w * text_scaling, h * text_scaling, 24); // should be initialized to black
+	Bitmap buffer(key.w * text_scaling, key.h * text_scaling, 24); // should be initialized to black
 	wxMemoryDC mdc;
 	mdc.SelectObject(buffer);
 	clearDC_black(mdc);
 	// now draw the text
 	mdc.SetFont(dc.GetFont());
 	mdc.SetTextForeground(*wxWHITE);
-	mdc.DrawRotatedText(text, xsub, ysub, rad_to_deg(angle));
+	mdc.DrawRotatedText(key.text, key.xsub, key.ysub, rad_to_deg(key.angle));
 	// get image
 	mdc.SelectObject(wxNullBitmap);
 	// step 2. sample down
-	double ca = fabs(cos(angle)), sa = fabs(sin(angle));
-	w += int(w * (stretch - 1) * ca); // GCC makes annoying conversion warnings if *= is used here.
-	h += int(h * (stretch - 1) * sa);
+	double ca = fabs(cos(key.angle)), sa = fabs(sin(key.angle));
+	int w = key.w, h = key.h;
+	w += int(w * (key.stretch - 1) * ca); // GCC makes annoying conversion warnings if *= is used here.
+	h += int(h * (key.stretch - 1) * sa);
 	Image img_small(w, h, false);
-	fill_image(img_small, color);
 	downsample_to_alpha(buffer, img_small);
+	// blur
+	for (int i = 0 ; i < key.blur_radius ; ++i) {
+		blur_image_alpha(img_small);
+	}
+	// keep only the alpha channel
+	TextRunMaskP mask(new TextRunMask);
+	mask->size = wxSize(w, h);
+	if (img_small.HasAlpha()) {
+		mask->alpha.assign(img_small.GetAlpha(), img_small.GetAlpha() + w * h);
+	}
+	return mask;
+}
+
+Image resampled_text_image(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius, wxPoint& pos_out) {
+	// transparent text can be ignored
+	if (color.alpha == 0) return Image();
+	TextRunKey key;
+	key.text        = text;
+	key.font        = dc.GetFont().GetNativeFontInfoDesc();
+	key.angle       = angle;
+	key.stretch     = stretch;
+	key.blur_radius = blur_radius;
+	// enlarge slightly; some fonts are larger then the GetTextExtent tells us (especially italic fonts)
+	key.w = static_cast<int>(rect.width) + 3 + 2 * blur_radius;
+	key.h = static_cast<int>(rect.height) + 1 + 2 * blur_radius;
+	// determine sub-pixel position
+	int xi = static_cast<int>(rect.x) - blur_radius / text_scaling,
+	    yi = static_cast<int>(rect.y) - blur_radius / text_scaling;
+	key.xsub = static_cast<int>(text_scaling * (pos.x - xi));
+	key.ysub = static_cast<int>(text_scaling * (pos.y - yi));
+	// find or render the alpha mask
+	TextRunMaskP mask;
+	if (!text_run_cache.get(key, mask)) {
+		mask = render_text_run_alpha(dc, key);
+		text_run_cache.put(key, mask, mask->alpha.size() + sizeof(TextRunMask) + sizeof(Char) * text.size() + sizeof(TextRunKey));
+	}
+	if (mask->alpha.empty()) return Image(); // downsampling failed
+	// step 3. colorize
+	Image img_small(mask->size.x, mask->size.y, false);
+	fill_image(img_small, color);
+	set_alpha(img_small, &mask->alpha[0], mask->size); // copies the alpha channel
 	// multiply alpha
 	if (color.alpha != 255) {
 		set_alpha(img_small, color.alpha / 255.);
 	}
-	// blur
-	for (int i = 0 ; i < blur_radius ; ++i) {
-		blur_image_alpha(img_small);
-	}
-	// step 3. draw to dc
+	pos_out = wxPoint(xi, yi);
+	return img_small;
+}
+
+// Draw text by first drawing it using a larger font and then downsampling it
+// optionally rotated by an angle
+void draw_resampled_text(DC& dc, const RealPoint& pos, const RealRect& rect, double stretch, Radians angle, AColor color, const String& text, int blur_radius, int repeat) {
+	wxPoint pos_out;
+	Image img = resampled_text_image(dc, pos, rect, stretch, angle, color, text, blur_radius, pos_out);
+	if (!img.Ok()) return;
+	// step 4. draw to dc
 	for (int i = 0 ; i < repeat ; ++i) {
-		dc.DrawBitmap(img_small, xi, yi);
+		dc.DrawBitmap(img, pos_out.x, pos_out.y);
 	}
 }
 
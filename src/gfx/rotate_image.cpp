@@ -8,36 +8,66 @@
 
 #include <util/prec.hpp>
 #include <gfx/gfx.hpp>
+#include <util/parallel.hpp>
 
 // ----------------------------------------------------------------------------- : Implementation
 
-// Rotates an image
+// Size of the tiles used for rotating
+const int rotate_tile_size = 64;
+
+// Rotates the pixels of an image, the pixels are of type T (RGB or alpha bytes)
 // 'Rotater' is a function object that knows how to 'rotate' a pixel coordinate
+// The image is done in square tiles, so both the rows that are read and the columns that are written
+// stay in the cache. Rows of tiles are done in parallel for large images.
+template <class Rotater, typename T>
+class RotatePass : public ParallelTask {
+  public:
+	RotatePass(const T* in, T* out, UInt width, UInt height)
+		: in(in), out(out), width(width), height(height)
+	{}
+	
+	/// Rotate the rows of tiles [begin..end)
+	virtual void run(int begin, int end) {
+		UInt y_end = min(height, (UInt)end * rotate_tile_size);
+		for (UInt ty = begin * rotate_tile_size ; ty < y_end ; ty += rotate_tile_size) {
+			for (UInt tx = 0 ; tx < width ; tx += rotate_tile_size) {
+				UInt y_tile_end = min(height, ty + rotate_tile_size);
+				UInt x_tile_end = min(width,  tx + rotate_tile_size);
+				for (UInt y = ty ; y < y_tile_end ; ++y) {
+					const T* row = in + y * width;
+					for (UInt x = tx ; x < x_tile_end ; ++x) {
+						out[Rotater::offset(x, y, width, height)] = row[x];
+					}
+				}
+			}
+		}
+	}
+	
+  private:
+	const T* in;
+	T*       out;
+	UInt     width, height;
+};
+
+template <class Rotater, typename T>
+void rotate_pixels(const T* in, T* out, UInt width, UInt height) {
+	RotatePass<Rotater,T> pass(in, out, width, height);
+	int tile_rows = (height + rotate_tile_size - 1) / rotate_tile_size;
+	parallel_for(pass, tile_rows, 1 + (1 << 16) / max(1, (int)width * rotate_tile_size));
+}
+
+// Rotates an image
 template <class Rotater>
 Image rotate_image_impl(Image img) {
 	UInt width = img.GetWidth(), height = img.GetHeight();
 	// initialize the return image
 	Image ret;
 	Rotater::init(ret, width, height);
-	Byte* in = img.GetData(), *out = ret.GetData();
-	// rotate each pixel
-	for (UInt y = 0 ; y < height ; ++y) {
-		for (UInt x = 0 ; x < width ; ++x) {
-			memcpy(out + 3 * Rotater::offset(x, y, width, height), in, 3);
-			in += 3;
-		}
-	}
+	rotate_pixels<Rotater>((const RGB*)img.GetData(), (RGB*)ret.GetData(), width, height);
 	// don't forget alpha
 	if (img.HasAlpha()) {
 		ret.InitAlpha();
-		in  = img.GetAlpha();
-		out = ret.GetAlpha();
-		for (UInt y = 0 ; y < height ; ++y) {
-			for (UInt x = 0 ; x < width ; ++x) {
-				out[Rotater::offset(x, y, width, height)] = *in;
-				in += 1;
-			}
-		}
+		rotate_pixels<Rotater>((const Byte*)img.GetAlpha(), ret.GetAlpha(), width, height);
 	}
 	// ret is rotated image
 	return ret;
@@ -134,3 +164,35 @@ Image flip_image_vertical(Image const& img) {
 	}
 	return out;
 }
+
+// ----------------------------------------------------------------------------- : Flipping images in place
+
+// reverse each of the n rows of w pixels
+template <typename T>
+void flip_rows_in_place(T* data, int w, int h) {
+	for (int y = 0 ; y < h ; ++y) {
+		reverse(data + y * w, data + (y + 1) * w);
+	}
+}
+// reverse the order of n rows of 'step' bytes
+void flip_columns_in_place(Byte* data, int step, int n) {
+	for (int i = 0, j = n-1 ; i < j ; ++i, --j) {
+		swap_ranges(data + i * step, data + (i + 1) * step, data + j * step);
+	}
+}
+
+void flip_image_horizontal_in_place(Image& img) {
+	int w = img.GetWidth(), h = img.GetHeight();
+	flip_rows_in_place((RGB*)img.GetData(), w, h);
+	if (img.HasAlpha()) {
+		flip_rows_in_place(img.GetAlpha(), w, h);
+	}
+}
+
+void flip_image_vertical_in_place(Image& img) {
+	int w = img.GetWidth(), h = img.GetHeight();
+	flip_columns_in_place(img.GetData(), 3 * w, h);
+	if (img.HasAlpha()) {
+		flip_columns_in_place(img.GetAlpha(), w, h);
+	}
+}
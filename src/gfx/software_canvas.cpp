@@ -0,0 +1,355 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <gfx/software_canvas.hpp>
+#include <util/angle.hpp>
+
+// ----------------------------------------------------------------------------- : SoftwareCanvas
+
+SoftwareCanvas::SoftwareCanvas(int width, int height, const Color& background)
+	: image(max(1, width), max(1, height), false)
+	, pen_color(0,0,0), brush_color(255,255,255)
+	, pen_width(1), has_pen(true), has_brush(true)
+	, function(wxCOPY)
+	, clipping(false)
+{
+	Clear(background);
+}
+
+// ----------------------------------------------------------------------------- : Properties
+
+void SoftwareCanvas::SetPen(const wxPen& pen) {
+	has_pen = pen.IsOk() && (int)pen.GetStyle() != wxTRANSPARENT;
+	if (has_pen) {
+		Color c = pen.GetColour();
+		pen_color = AColor(c, c.Alpha());
+		pen_width = max(1, pen.GetWidth());
+	}
+}
+
+void SoftwareCanvas::SetBrush(const wxBrush& brush) {
+	has_brush = brush.IsOk() && (int)brush.GetStyle() != wxTRANSPARENT;
+	if (has_brush) {
+		Color c = brush.GetColour();
+		brush_color = AColor(c, c.Alpha());
+	}
+}
+
+void SoftwareCanvas::SetLogicalFunction(int function) {
+	this->function = function;
+}
+
+void SoftwareCanvas::SetClippingRegion(const wxRegion& region) {
+	clipping = true;
+	clip_rects.clear();
+	for (wxRegionIterator it(region) ; it ; ++it) {
+		clip_rects.push_back(it.GetRect());
+	}
+}
+
+void SoftwareCanvas::DestroyClippingRegion() {
+	clipping = false;
+	clip_rects.clear();
+}
+
+// ----------------------------------------------------------------------------- : Spans
+
+void SoftwareCanvas::visibleSpans(int y, int x_begin, int x_end, vector<pair<int,int> >& spans) const {
+	spans.clear();
+	if (y < 0 || y >= GetHeight()) return;
+	x_begin = max(0, x_begin);
+	x_end   = min(GetWidth(), x_end);
+	if (x_begin >= x_end) return;
+	if (!clipping) {
+		spans.push_back(make_pair(x_begin, x_end));
+		return;
+	}
+	// the rectangles of a region don't overlap, so each pixel is in at most one span
+	for (size_t i = 0 ; i < clip_rects.size() ; ++i) {
+		const wxRect& r = clip_rects[i];
+		if (y < r.y || y >= r.y + r.height) continue;
+		int b = max(x_begin, r.x), e = min(x_end, r.x + r.width);
+		if (b < e) spans.push_back(make_pair(b, e));
+	}
+}
+
+void SoftwareCanvas::fillSpan(int y, int x_begin, int x_end, const AColor& color) {
+	if (color.alpha == 0 && function == wxCOPY) return;
+	vector<pair<int,int> >& spans = span_buffer;
+	visibleSpans(y, x_begin, x_end, spans);
+	Byte* row = image.GetData() + 3 * y * GetWidth();
+	Byte c[3] = { color.Red(), color.Green(), color.Blue() };
+	int a = color.alpha;
+	for (size_t i = 0 ; i < spans.size() ; ++i) {
+		Byte* p   = row + 3 * spans[i].first;
+		Byte* end = row + 3 * spans[i].second;
+		for ( ; p < end ; p += 3) {
+			for (int j = 0 ; j < 3 ; ++j) {
+				switch (function) {
+					case wxINVERT: p[j] = 255 - p[j]; break;
+					case wxAND:    p[j] &= c[j];      break;
+					case wxOR:     p[j] |= c[j];      break;
+					case wxXOR:    p[j] ^= c[j];      break;
+					default:
+						p[j] = a == 255 ? c[j] : (Byte)div255(c[j] * a + p[j] * (255 - a));
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------- : Shapes
+
+void SoftwareCanvas::fillPolygon(const vector<RealPoint>& points, const AColor& color) {
+	size_t n = points.size();
+	if (n < 3) return;
+	double y_min = points[0].y, y_max = points[0].y;
+	for (size_t i = 1 ; i < n ; ++i) {
+		y_min = min(y_min, points[i].y);
+		y_max = max(y_max, points[i].y);
+	}
+	int y_begin = max(0,           (int)ceil(y_min - 0.5));
+	int y_end   = min(GetHeight(), (int)ceil(y_max - 0.5));
+	vector<double> xs;
+	for (int y = y_begin ; y < y_end ; ++y) {
+		// intersect the edges with the line through the pixel centers
+		double yc = y + 0.5;
+		xs.clear();
+		for (size_t i = 0 ; i < n ; ++i) {
+			const RealPoint& a = points[i];
+			const RealPoint& b = points[i + 1 < n ? i + 1 : 0];
+			if ((a.y <= yc && yc < b.y) || (b.y <= yc && yc < a.y)) {
+				xs.push_back(a.x + (yc - a.y) * (b.x - a.x) / (b.y - a.y));
+			}
+		}
+		sort(xs.begin(), xs.end());
+		for (size_t i = 0 ; i + 1 < xs.size() ; i += 2) {
+			fillSpan(y, (int)ceil(xs[i] - 0.5), (int)ceil(xs[i+1] - 0.5), color);
+		}
+	}
+}
+
+void SoftwareCanvas::strokeThinLine(int x0, int y0, int x1, int y1, const AColor& color) {
+	// Bresenham
+	int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+	int dy = abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+	int err = dx - dy;
+	while (x0 != x1 || y0 != y1) {
+		fillSpan(y0, x0, x0 + 1, color);
+		int e2 = 2 * err;
+		if (e2 > -dy) { err -= dy; x0 += sx; }
+		if (e2 <  dx) { err += dx; y0 += sy; }
+	}
+}
+
+/// Points on an ellipse from angle start to end (in radians, counterclockwise)
+void ellipse_points(double cx, double cy, double rx, double ry, double start, double end, vector<RealPoint>& out) {
+	int steps = max(4, (int)(fabs(end - start) * max(rx, ry) / 2));
+	for (int i = 0 ; i <= steps ; ++i) {
+		double a = start + (end - start) * i / steps;
+		out.push_back(RealPoint(cx + rx * cos(a), cy - ry * sin(a)));
+	}
+}
+
+void SoftwareCanvas::strokePolyline(const vector<RealPoint>& points, bool closed) {
+	if (!has_pen || points.empty()) return;
+	size_t n = points.size();
+	size_t segments = closed ? n : n - 1;
+	if (pen_width <= 1) {
+		for (size_t i = 0 ; i < segments ; ++i) {
+			const RealPoint& a = points[i];
+			const RealPoint& b = points[(i + 1) % n];
+			strokeThinLine(to_int(a.x), to_int(a.y), to_int(b.x), to_int(b.y), pen_color);
+		}
+		return;
+	}
+	// thick lines: a rectangle for each segment, and a disc at each joint
+	// the points are pixel positions, pixel (x,y) covers the area [x..x+1) * [y..y+1)
+	double r = 0.5 * pen_width;
+	RealPoint half(0.5, 0.5);
+	vector<RealPoint> shape;
+	for (size_t i = 0 ; i < segments ; ++i) {
+		RealPoint a = points[i] + half;
+		RealPoint b = points[(i + 1) % n] + half;
+		RealPoint d = b - a;
+		double len = sqrt(d.x * d.x + d.y * d.y);
+		if (len <= 0) continue;
+		RealPoint normal(-d.y * r / len, d.x * r / len);
+		shape.clear();
+		shape.push_back(a + normal);
+		shape.push_back(b + normal);
+		shape.push_back(b - normal);
+		shape.push_back(a - normal);
+		fillPolygon(shape, pen_color);
+	}
+	if (pen_width > 2) {
+		for (size_t i = closed ? 0 : 1 ; i < (closed ? n : n - 1) ; ++i) {
+			shape.clear();
+			ellipse_points(points[i].x + 0.5, points[i].y + 0.5, r, r, 0, rad360, shape);
+			fillPolygon(shape, pen_color);
+		}
+	}
+}
+
+void SoftwareCanvas::drawShape(const vector<RealPoint>& fill, const vector<RealPoint>& outline, bool closed) {
+	if (has_brush) fillPolygon(fill, brush_color);
+	strokePolyline(outline, closed);
+}
+
+// ----------------------------------------------------------------------------- : Drawing
+
+void SoftwareCanvas::Clear(const Color& color) {
+	Byte c[3] = { color.Red(), color.Green(), color.Blue() };
+	Byte* data = image.GetData();
+	size_t n = (size_t)GetWidth() * GetHeight();
+	for (size_t i = 0 ; i < n ; ++i) {
+		data[3*i+0] = c[0];
+		data[3*i+1] = c[1];
+		data[3*i+2] = c[2];
+	}
+}
+
+void SoftwareCanvas::DrawImage(const Image& img, int x, int y, ImageCombine combine) {
+	if (!img.Ok()) return;
+	// the part of the image that is on the canvas
+	wxRect r = wxRect(x, y, img.GetWidth(), img.GetHeight()).Intersect(wxRect(0, 0, GetWidth(), GetHeight()));
+	if (r.width <= 0 || r.height <= 0) return;
+	Image src = r.width == img.GetWidth() && r.height == img.GetHeight()
+	          ? img
+	          : img.GetSubImage(wxRect(r.x - x, r.y - y, r.width, r.height));
+	if (combine > COMBINE_NORMAL) {
+		// combine with what is already there, as draw_combine_image does
+		Image below = GetSubImage(r);
+		combine_image(below, src, combine);
+		src = below;
+	}
+	// blend
+	const Byte* data  = src.GetData();
+	const Byte* alpha = src.HasAlpha() ? src.GetAlpha() : nullptr;
+	bool mask = !alpha && src.HasMask();
+	Byte mr = 0, mg = 0, mb = 0;
+	if (mask) src.GetOrFindMaskColour(&mr, &mg, &mb);
+	vector<pair<int,int> > spans;
+	for (int sy = 0 ; sy < r.height ; ++sy) {
+		visibleSpans(r.y + sy, r.x, r.x + r.width, spans);
+		Byte* row = image.GetData() + 3 * ((r.y + sy) * GetWidth());
+		for (size_t i = 0 ; i < spans.size() ; ++i) {
+			for (int dx = spans[i].first ; dx < spans[i].second ; ++dx) {
+				int sx = dx - r.x;
+				const Byte* s = data + 3 * (sy * r.width + sx);
+				Byte*       d = row  + 3 * dx;
+				int a = 255;
+				if (alpha) {
+					a = alpha[sy * r.width + sx];
+				} else if (mask && s[0] == mr && s[1] == mg && s[2] == mb) {
+					a = 0;
+				}
+				if (a == 255) {
+					d[0] = s[0]; d[1] = s[1]; d[2] = s[2];
+				} else if (a != 0) {
+					d[0] = (Byte)div255(s[0] * a + d[0] * (255 - a));
+					d[1] = (Byte)div255(s[1] * a + d[1] * (255 - a));
+					d[2] = (Byte)div255(s[2] * a + d[2] * (255 - a));
+				}
+			}
+		}
+	}
+}
+
+void SoftwareCanvas::DrawLine(const wxPoint& p1, const wxPoint& p2) {
+	vector<RealPoint> points;
+	points.push_back(RealPoint(p1.x, p1.y));
+	points.push_back(RealPoint(p2.x, p2.y));
+	strokePolyline(points, false);
+}
+
+void SoftwareCanvas::DrawRectangle(const wxRect& rect) {
+	if (rect.width <= 0 || rect.height <= 0) return;
+	int x0 = rect.x, x1 = rect.x + rect.width;
+	int y0 = rect.y, y1 = rect.y + rect.height;
+	if (has_brush) {
+		for (int y = y0 ; y < y1 ; ++y) fillSpan(y, x0, x1, brush_color);
+	}
+	if (has_pen) {
+		// the border is drawn on the inside of the rectangle
+		int w = min(pen_width, min(rect.width, rect.height) / 2 + 1);
+		for (int y = y0 ; y < y1 ; ++y) {
+			if (y < y0 + w || y >= y1 - w) {
+				fillSpan(y, x0, x1, pen_color);
+			} else {
+				fillSpan(y, x0, x0 + w, pen_color);
+				fillSpan(y, x1 - w, x1, pen_color);
+			}
+		}
+	}
+}
+
+/// Outline of a rounded rectangle
+void rounded_rectangle_points(double x0, double y0, double x1, double y1, double r, vector<RealPoint>& out) {
+	r = min(r, 0.5 * min(x1 - x0, y1 - y0));
+	ellipse_points(x1 - r, y0 + r, r, r, 0,      rad90,  out);
+	ellipse_points(x0 + r, y0 + r, r, r, rad90,  rad180, out);
+	ellipse_points(x0 + r, y1 - r, r, r, rad180, rad270, out);
+	ellipse_points(x1 - r, y1 - r, r, r, rad270, rad360, out);
+}
+
+void SoftwareCanvas::DrawRoundedRectangle(const wxRect& rect, double radius) {
+	if (radius <= 0) {
+		DrawRectangle(rect);
+		return;
+	}
+	if (rect.width <= 0 || rect.height <= 0) return;
+	// the area is [x..x+w) for filling, the outline goes through the border pixels x and x+w-1
+	vector<RealPoint> fill, outline;
+	rounded_rectangle_points(rect.x, rect.y, rect.x + rect.width,     rect.y + rect.height,     radius, fill);
+	rounded_rectangle_points(rect.x, rect.y, rect.x + rect.width - 1, rect.y + rect.height - 1, radius, outline);
+	drawShape(fill, outline, true);
+}
+
+void SoftwareCanvas::DrawPolygon(int n, const wxPoint* points, int x_offset, int y_offset) {
+	vector<RealPoint> shape;
+	for (int i = 0 ; i < n ; ++i) {
+		shape.push_back(RealPoint(points[i].x + x_offset, points[i].y + y_offset));
+	}
+	drawShape(shape, shape, true);
+}
+
+void SoftwareCanvas::DrawEllipse(const wxRect& b) {
+	if (b.width <= 0 || b.height <= 0) return;
+	vector<RealPoint> fill, outline;
+	ellipse_points(b.x + 0.5 *  b.width,      b.y + 0.5 *  b.height,      0.5 *  b.width,      0.5 *  b.height,      0, rad360, fill);
+	ellipse_points(b.x + 0.5 * (b.width - 1), b.y + 0.5 * (b.height - 1), 0.5 * (b.width - 1), 0.5 * (b.height - 1), 0, rad360, outline);
+	drawShape(fill, outline, true);
+}
+
+void SoftwareCanvas::DrawEllipticArc(const wxRect& b, double start, double end) {
+	if (b.width <= 0 || b.height <= 0) return;
+	Radians s = deg_to_rad(start), e = deg_to_rad(end);
+	while (e <= s) e += rad360;
+	double cx = b.x + 0.5 * b.width, cy = b.y + 0.5 * b.height;
+	vector<RealPoint> fill, outline;
+	fill.push_back(RealPoint(cx, cy));
+	ellipse_points(cx, cy, 0.5 * b.width, 0.5 * b.height, s, e, fill);
+	outline.push_back(RealPoint(cx - 0.5, cy - 0.5));
+	ellipse_points(cx - 0.5, cy - 0.5, 0.5 * (b.width - 1), 0.5 * (b.height - 1), s, e, outline);
+	drawShape(fill, outline, true);
+}
+
+// ----------------------------------------------------------------------------- : Other
+
+Image SoftwareCanvas::GetSubImage(const wxRect& rect) const {
+	wxRect r = rect.Intersect(wxRect(0, 0, GetWidth(), GetHeight()));
+	if (r == rect) return image.GetSubImage(rect);
+	// part is outside the canvas, leave that black
+	Image out(max(1, rect.width), max(1, rect.height), true);
+	if (r.width > 0 && r.height > 0) {
+		out.Paste(image.GetSubImage(r), r.x - rect.x, r.y - rect.y);
+	}
+	return out;
+}
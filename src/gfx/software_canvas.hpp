@@ -0,0 +1,98 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_GFX_SOFTWARE_CANVAS
+#define HEADER_GFX_SOFTWARE_CANVAS
+
+/** @file gfx/software_canvas.hpp
+ *
+ *  @brief Drawing into an image in memory, without going through a DC.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <util/real_point.hpp>
+#include <gfx/gfx.hpp>
+
+// ----------------------------------------------------------------------------- : SoftwareCanvas
+
+/// An RGB image in memory that can be drawn on like a DC
+/** This is the backend used by RotatedDC when rendering offscreen.
+ *  Images, shapes and (already rendered) text are composited directly into the image data,
+ *  instead of being blitted to and from a DC.
+ *
+ *  Shapes are not anti-aliased: like with a DC, a pixel is drawn when its center is inside the shape.
+ *  All coordinates are in pixels.
+ */
+class SoftwareCanvas {
+  public:
+	/// Create a canvas of the given size, filled with a background color
+	SoftwareCanvas(int width, int height, const Color& background = *wxWHITE);
+
+	inline int GetWidth()  const { return image.GetWidth();  }
+	inline int GetHeight() const { return image.GetHeight(); }
+	/// The image that has been drawn
+	inline const Image& getImage() const { return image; }
+	/// A DC that can be used for selecting fonts and measuring text, drawing to it has no effect
+	inline wxDC& getMeasuringDC() { return measuring_dc; }
+
+	// --------------------------------------------------- : Properties
+
+	void SetPen(const wxPen& pen);
+	void SetBrush(const wxBrush& brush);
+	/// Only wxCOPY, wxINVERT, wxAND, wxOR and wxXOR are supported
+	void SetLogicalFunction(int function);
+	/// Only draw inside the given region
+	void SetClippingRegion(const wxRegion& region);
+	void DestroyClippingRegion();
+
+	// --------------------------------------------------- : Drawing
+
+	/// Fill the whole canvas with a color, ignoring clipping
+	void Clear(const Color& color);
+	/// Draw an image with its top-left corner at (x,y), using its alpha channel or mask
+	/** Like draw_combine_image, the image is first combined with what is already on the canvas */
+	void DrawImage(const Image& img, int x, int y, ImageCombine combine = COMBINE_NORMAL);
+	/// Draw a line with the current pen, the end point is not drawn
+	void DrawLine(const wxPoint& p1, const wxPoint& p2);
+	void DrawRectangle(const wxRect& rect);
+	void DrawRoundedRectangle(const wxRect& rect, double radius);
+	void DrawPolygon(int n, const wxPoint* points, int x_offset = 0, int y_offset = 0);
+	void DrawEllipse(const wxRect& bounds);
+	/// Draw a slice of the ellipse inside bounds, angles are in degrees (counterclockwise)
+	void DrawEllipticArc(const wxRect& bounds, double start, double end);
+
+	/// Get a copy of part of the canvas
+	Image GetSubImage(const wxRect& rect) const;
+
+  private:
+	Image      image;
+	wxMemoryDC measuring_dc;
+	AColor     pen_color, brush_color;
+	int        pen_width;
+	bool       has_pen, has_brush;
+	int        function;
+	bool       clipping;
+	vector<wxRect> clip_rects; ///< The clipping region, as disjoint rectangles
+	vector<pair<int,int> > span_buffer; ///< Reused by fillSpan
+
+	/// Parts of [x_begin..x_end) on row y that are inside the canvas and the clipping region
+	void visibleSpans(int y, int x_begin, int x_end, vector<pair<int,int> >& spans) const;
+	/// Fill the pixels [x_begin..x_end) on row y with a color, using the logical function
+	void fillSpan(int y, int x_begin, int x_end, const AColor& color);
+	/// Fill the pixels with their center inside a polygon (odd-even rule)
+	void fillPolygon(const vector<RealPoint>& points, const AColor& color);
+	/// Draw the outline of a polygon or polyline with the current pen
+	void strokePolyline(const vector<RealPoint>& points, bool closed);
+	/// Draw a one pixel wide line from a to b, excluding b
+	void strokeThinLine(int x0, int y0, int x1, int y1, const AColor& color);
+	/// Fill with the current brush and outline with the current pen
+	void drawShape(const vector<RealPoint>& fill, const vector<RealPoint>& outline, bool closed);
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
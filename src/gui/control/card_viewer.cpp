@@ -21,7 +21,7 @@ DEFINE_EVENT_TYPE(EVENT_SIZE_CHANGE);
 
 CardViewer::CardViewer(Window* parent, int id, long style)
 	: wxControl(parent, id, wxDefaultPosition, wxDefaultSize, wxBORDER_THEME_FIX(style))
-	, up_to_date(false)
+	, up_to_date(false), painting(false), all_changed_while_painting(false)
 {}
 
 wxSize CardViewer::DoGetBestSize() const {
@@ -40,9 +40,29 @@ void CardViewer::redraw(const ValueViewer& v) {
 	// Don't refresh if we OR ANOTHER CardViewer is drawing
 	// drawing another viewer causes styles to be updated for its active card, which may be different,
 	// causing the two viewers to continously refresh.
-	if (drawing_card()) return;
+	invalidateLayer(v);
+	if (drawing_card()) {
+		if (painting) {
+			// a style was updated by our own drawing, the viewer may be outside the area being painted
+			Rotation rot = getRotation();
+			changed_while_painting.push_back(rot.trRectToBB(v.boundingBox()));
+			changed_while_painting.push_back(rot.trRectToBB(v.drawn_box));
+		}
+		return;
+	}
 	up_to_date = false;
-	RefreshRect(getRotation().trRectToBB(v.boundingBox()), false);
+	refreshViewer(v);
+}
+
+void CardViewer::refreshViewer(const ValueViewer& v) {
+	// redraw both the new area of the viewer and the area it was drawn in before
+	Rotation rot = getRotation();
+	wxRect new_box = rot.trRectToBB(v.boundingBox());
+	wxRect old_box = rot.trRectToBB(v.drawn_box);
+	RefreshRect(new_box, false);
+	if (old_box != new_box && old_box.width > 0 && old_box.height > 0) {
+		RefreshRect(old_box, false);
+	}
 }
 
 void CardViewer::onChange() {
@@ -50,7 +70,10 @@ void CardViewer::onChange() {
 }
 
 void CardViewer::redraw() {
-	if (drawing_card()) return;
+	if (drawing_card()) {
+		if (painting) all_changed_while_painting = true;
+		return;
+	}
 	up_to_date = false;
 	Refresh(false);
 }
@@ -92,9 +115,26 @@ void CardViewer::onPaint(wxPaintEvent&) {
 	// draw
 	if (!up_to_date) {
 		up_to_date = true;
+		painting = true;
 		try {
 			draw(dc);
 		} CATCH_ALL_ERRORS(false); // don't show message boxes in onPaint!
+		painting = false;
+		// paint what changed because of updated styles, outside the area that was just painted
+		if (isPartialDraw()) {
+			if (all_changed_while_painting) {
+				up_to_date = false;
+				Refresh(false);
+			} else if (!changed_while_painting.empty()) {
+				up_to_date = false;
+				for (size_t i = 0 ; i < changed_while_painting.size() ; ++i) {
+					const wxRect& r = changed_while_painting[i];
+					if (r.width > 0 && r.height > 0) RefreshRect(r, false);
+				}
+			}
+		}
+		changed_while_painting.clear();
+		all_changed_while_painting = false;
 	}
 }
 
@@ -109,6 +149,10 @@ bool CardViewer::shouldDraw(const ValueViewer& v) const {
 	return GetUpdateRegion().Contains(getRotation().trRectToBB(v.boundingBox().toRect()).toRect()) != wxOutRegion;
 }
 
+bool CardViewer::isPartialDraw() const {
+	return GetUpdateRegion().Contains(wxRect(GetClientSize())) != wxInRegion;
+}
+
 // helper class for overdrawDC()
 class CardViewer::OverdrawDC_aux : private wxClientDC {
   protected:
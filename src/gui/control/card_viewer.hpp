@@ -49,6 +49,7 @@ class CardViewer : public wxControl, public DataViewer {
 	
 	/// Should the given viewer be drawn?
 	bool shouldDraw(const ValueViewer&) const;
+	virtual bool isPartialDraw() const;
 	
 	virtual void drawViewer(RotatedDC& dc, ValueViewer& v);
 	
@@ -60,6 +61,14 @@ class CardViewer : public wxControl, public DataViewer {
 	
 	Bitmap buffer;     ///< Off-screen buffer we draw to
 	bool   up_to_date; ///< Is the buffer up to date?
+	bool   painting;   ///< Are we inside onPaint?
+	/// Areas that changed while painting, because style scripts are updated as part of drawing.
+	/** They may be outside the area being painted, so they are refreshed afterwards. */
+	vector<wxRect> changed_while_painting;
+	bool           all_changed_while_painting;
+	
+	/// Refresh both the current area of a viewer and the area it was last drawn in
+	void refreshViewer(const ValueViewer& v);
 	
 	class OverdrawDC;
 	class OverdrawDC_aux;
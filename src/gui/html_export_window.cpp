@@ -77,6 +77,8 @@ ScriptValueP export_set(SetP const& set, vector<CardP> const& cards, ExportTempl
 	ctx.setVariable(_("options"),   to_script(&settings.exportOptionsFor(*exp)));
 	ctx.setVariable(_("directory"), to_script(info.directory_relative));
 	ScriptValueP result = exp->script.invoke(ctx);
+	// wait for the files written by the script
+	info.finishWriting();
 	// Save to file
 	if (!outname.empty()) {
 		// TODO: write as image?
@@ -67,7 +67,9 @@ void ImagesExportWindow::onOk(wxCommandEvent&) {
 	if (name.empty()) return;
 	settings.default_export_dir = wxPathOnly(name);
 	// Export
-	export_images(set, getSelection(), name, gs.images_export_filename, gs.images_export_conflicts);
+	ExportImagesOptions options;
+	options.conflicts = gs.images_export_conflicts;
+	export_images(set, getSelection(), name, gs.images_export_filename, options);
 	// Done
 	EndModal(wxID_OK);
 }
@@ -14,6 +14,8 @@
 #include <data/card.hpp>
 #include <data/stylesheet.hpp>
 #include <render/card/viewer.hpp>
+#include <gfx/software_canvas.hpp>
+#include <util/lru_cache.hpp>
 #include <wx/print.h>
 
 DECLARE_TYPEOF_COLLECTION(CardP);
@@ -49,6 +51,91 @@ void PageLayout::init(const StyleSheet& stylesheet, PageLayoutType type, const R
 	}
 }
 
+// ----------------------------------------------------------------------------- : PrintCardCache
+
+/// How a card was rendered for printing
+struct PrintCardKey {
+	PrintCardKey(const CardP& card, Radians angle, double zoom) : card(card), angle(angle), zoom(zoom) {}
+	CardP   card;
+	Radians angle;
+	double  zoom;
+	
+	inline bool operator < (const PrintCardKey& that) const {
+		if (card  != that.card)  return card  < that.card;
+		if (angle != that.angle) return angle < that.angle;
+		return zoom < that.zoom;
+	}
+};
+
+/// Renders cards for printing, and keeps the most recently used images
+/** The print preview asks for the same pages again when the user goes back and forth,
+ *  so rendered cards are kept, up to a budget in bytes.
+ *  Everything is forgotten when the set changes.
+ */
+class PrintCardCache : public SetView {
+  public:
+	PrintCardCache(const SetP& set);
+	
+	/// Get an image of a card, rendered with the given rotation and zoom
+	Image get(const CardP& card, Radians angle, double zoom);
+	/// Has the card already been rendered with the given rotation and zoom?
+	bool contains(const CardP& card, Radians angle, double zoom) const;
+	
+  protected:
+	virtual void onAction(const Action&, bool undone);
+	
+  private:
+	LruCache<PrintCardKey,Image> images;
+	map<StyleSheetP, shared_ptr<DataViewer> > viewers; ///< A viewer for each stylesheet, like in CardBitmapExporter
+	
+	/// Draw a card offscreen
+	Image render(const CardP& card, Radians angle, double zoom);
+};
+
+/// Budget in bytes for the cards kept by a PrintCardCache
+const size_t print_cache_size = 256 * 1024 * 1024;
+
+PrintCardCache::PrintCardCache(const SetP& set)
+	: images(print_cache_size)
+{
+	setSet(set);
+}
+
+Image PrintCardCache::get(const CardP& card, Radians angle, double zoom) {
+	PrintCardKey key(card, angle, zoom);
+	Image image;
+	if (!images.get(key, image)) {
+		image = render(card, angle, zoom);
+		images.put(key, image, 3 * (size_t)image.GetWidth() * image.GetHeight());
+	}
+	return image;
+}
+
+bool PrintCardCache::contains(const CardP& card, Radians angle, double zoom) const {
+	return images.contains(PrintCardKey(card, angle, zoom));
+}
+
+void PrintCardCache::onAction(const Action&, bool undone) {
+	// any change can affect how cards look
+	images.clear();
+}
+
+Image PrintCardCache::render(const CardP& card, Radians angle, double zoom) {
+	StyleSheetP stylesheet = set->stylesheetForP(card);
+	shared_ptr<DataViewer>& viewer = viewers[stylesheet];
+	if (!viewer) {
+		viewer = shared(new DataViewer());
+		viewer->setSet(set);
+	}
+	viewer->setCard(card);
+	Rotation rotation(angle, stylesheet->getCardRect(), zoom, 1.0, ROTATION_ATTACH_TOP_LEFT);
+	RealSize size = rotation.getExternalSize();
+	SoftwareCanvas canvas((int) size.width, (int) size.height, *wxWHITE);
+	RotatedDC rdc(canvas, rotation);
+	viewer->draw(rdc, *wxWHITE);
+	return canvas.getImage();
+}
+
 // ----------------------------------------------------------------------------- : Printout
 
 /// A printout object specifying how to print a specified set of cards
@@ -66,7 +153,7 @@ class CardsPrintout : public wxPrintout {
 	
   private:
 	PrintJobP job; ///< Cards to print
-	DataViewer viewer;
+	PrintCardCache cache;
 	double scale_x, scale_y; // priter pixel per mm
 	
 	int pageCount() {
@@ -75,13 +162,37 @@ class CardsPrintout : public wxPrintout {
 	
 	/// Draw a card, that is card_nr on this page, find the postion by asking the layout
 	void drawCard(DC& dc, const CardP& card, int card_nr);
+	/// Angle to print a card at
+	Radians cardAngle(const StyleSheet& stylesheet) const;
+	/// Zoom factor to render a card at, to match the resolution of the dc
+	double cardZoom(const StyleSheet& stylesheet) const;
+	
+	// --------------------------------------------------- : Rendering ahead
+	
+	/// Timer that renders the cards on the pages next to the one being previewed
+	class PrefetchTimer : public wxTimer {
+	  public:
+		PrefetchTimer(CardsPrintout& printout) : printout(printout) {}
+		virtual void Notify();
+	  private:
+		CardsPrintout& printout;
+	};
+	PrefetchTimer prefetch_timer;
+	int           prefetch_page; ///< The page being previewed
+	
+	/// Render one card on the pages around prefetch_page that is not in the cache yet
+	/** Returns false if there was nothing left to render */
+	bool prefetch();
 };
 
+/// Delay between rendering cards ahead of time, so the preview stays responsive (in ms)
+const int prefetch_delay = 10;
+
 CardsPrintout::CardsPrintout(PrintJobP const& job)
-	: job(job)
-{
-	viewer.setSet(job->set);
-}
+	: job(job), cache(job->set)
+	, scale_x(1), scale_y(1)
+	, prefetch_timer(*this), prefetch_page(0)
+{}
 
 void CardsPrintout::GetPageInfo(int* page_min, int* page_max, int* page_from, int* page_to) {
 	*page_from = *page_min = 1;
@@ -116,9 +227,28 @@ bool CardsPrintout::OnPrintPage(int page) {
 	for (int i = start ; i < end ; ++i) {
 		drawCard(dc, job->cards.at(i), i - start);
 	}
+	// render the neighbouring pages while the user looks at this one
+	if (IsPreview()) {
+		prefetch_page = page;
+		prefetch_timer.Start(prefetch_delay, wxTIMER_ONE_SHOT);
+	}
 	return true;
 }
 
+Radians CardsPrintout::cardAngle(const StyleSheet& stylesheet) const {
+	if ((stylesheet.card_width > stylesheet.card_height) != job->layout.card_landscape) {
+		return rad90;
+	} else {
+		return 0;
+	}
+}
+
+double CardsPrintout::cardZoom(const StyleSheet& stylesheet) const {
+	// the resolution of the dc, but not more than 4 times the resolution of the stylesheet
+	double px_per_mm = max(scale_x, scale_y);
+	return min(4.0, px_per_mm * 25.4 / stylesheet.card_dpi);
+}
+
 void CardsPrintout::drawCard(DC& dc, const CardP& card, int card_nr) {
 	// determine position
 	int col = card_nr % job->layout.cols;
@@ -127,10 +257,7 @@ void CardsPrintout::drawCard(DC& dc, const CardP& card, int card_nr) {
 	             , job->layout.margin_top  + (job->layout.card_size.height + job->layout.card_spacing.height) * row);
 	// determine rotation
 	const StyleSheet& stylesheet = job->set->stylesheetFor(card);
-	Radians rotation = 0;
-	if ((stylesheet.card_width > stylesheet.card_height) != job->layout.card_landscape) {
-		rotation = rad90;
-	}
+	Radians rotation = cardAngle(stylesheet);
 	/*
 	// size of this particular card (in mm)
 	RealSize card_size( stylesheet.card_width  * 25.4 / stylesheet.card_dpi
@@ -140,27 +267,50 @@ void CardsPrintout::drawCard(DC& dc, const CardP& card, int card_nr) {
 	// TODO: deal with different sized cards in general
 	*/
 	
-	// create buffers
-	int w = int(stylesheet.card_width), h = int(stylesheet.card_height); // in pixels
-	if (is_rad90(rotation)) swap(w,h);
-	// Draw using text buffer
-	double zoom = IsPreview() ? 1 : 4;
-	wxBitmap buffer(w*zoom,h*zoom,32);
-	wxMemoryDC bufferDC;
-	bufferDC.SelectObject(buffer);
-	clearDC(bufferDC,*wxWHITE_BRUSH);
-	RotatedDC rdc(bufferDC, rotation, stylesheet.getCardRect(), zoom, QUALITY_AA, ROTATION_ATTACH_TOP_LEFT);
-	// render card to dc
-	viewer.setCard(card);
-	viewer.draw(rdc, *wxWHITE);
+	// render card, or use the image from when this page was shown before
+	double zoom = cardZoom(stylesheet);
+	Bitmap buffer(cache.get(card, rotation, zoom));
 	// render buffer to device
 	double px_per_mm = zoom * stylesheet.card_dpi / 25.4;
 	dc.SetUserScale(scale_x / px_per_mm, scale_y / px_per_mm);
 	dc.SetDeviceOrigin(int(scale_x * pos.x), int(scale_y * pos.y));
-	bufferDC.SelectObject(wxNullBitmap);
 	dc.DrawBitmap(buffer, 0, 0);
 }
 
+// ----------------------------------------------------------------------------- : Printout : rendering ahead
+
+void CardsPrintout::PrefetchTimer::Notify() {
+	if (printout.prefetch()) {
+		Start(prefetch_delay, wxTIMER_ONE_SHOT);
+	}
+}
+
+bool CardsPrintout::prefetch() {
+	int per_page = job->layout.cards_per_page();
+	if (per_page <= 0) return false;
+	// the next page is the most likely to be needed, then the previous one
+	int pages[] = {prefetch_page + 1, prefetch_page - 1};
+	for (int p = 0 ; p < 2 ; ++p) {
+		if (pages[p] < 1 || pages[p] > pageCount()) continue;
+		int start = (pages[p] - 1) * per_page;
+		int end   = min((int)job->cards.size(), start + per_page);
+		for (int i = start ; i < end ; ++i) {
+			const CardP& card = job->cards.at(i);
+			const StyleSheet& stylesheet = job->set->stylesheetFor(card);
+			Radians angle = cardAngle(stylesheet);
+			double  zoom  = cardZoom(stylesheet);
+			if (!cache.contains(card, angle, zoom)) {
+				try {
+					cache.get(card, angle, zoom);
+					return true;
+				} CATCH_ALL_ERRORS(false);
+				return false; // don't keep failing on the same card
+			}
+		}
+	}
+	return false;
+}
+
 // ----------------------------------------------------------------------------- : PrintWindow
 
 PrintJobP make_print_job(Window* parent, const SetP& set, const ExportCardSelectionChoices& choices) {
@@ -78,6 +78,23 @@ void nag_about_ascii_version() {
 	#endif
 }
 
+// ----------------------------------------------------------------------------- : Command line progress
+
+/// Reports progress of --export-images on the console, in steps of 10%
+class CLIExportProgress : public ExportImagesProgress {
+  public:
+	CLIExportProgress() : last_step(-1) {}
+	virtual void onProgress(size_t done, size_t total) {
+		int step = total == 0 ? 10 : (int)(10 * done / total);
+		if (step == last_step) return;
+		last_step = step;
+		cli << String::Format(_("Exported %d of %d cards"), (int)done, (int)total) << ENDL;
+		cli.flush();
+	}
+  private:
+	int last_step;
+};
+
 // ----------------------------------------------------------------------------- : Initialization
 
 int MSE::OnRun() {
@@ -181,9 +198,25 @@ int MSE::OnRun() {
 					cli << _("\n\n  ") << BRIGHT << _("--export") << NORMAL << PARAM << _(" TEMPLATE SETFILE ") << NORMAL << _(" [") << PARAM << _("OUTFILE") << NORMAL << _("]");
 					cli << _("\n         \tExport a set using an export template.");
 					cli << _("\n         \tIf no output filename is specified, the result is written to stdout.");
-					cli << _("\n\n  ") << BRIGHT << _("--export-images") << NORMAL << PARAM << _(" SETFILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("]");
+					cli << _("\n\n  ") << BRIGHT << _("--export-images") << NORMAL << PARAM << _(" SETFILE") << NORMAL << _(" [") << PARAM << _("IMAGE") << NORMAL << _("] [")
+									   << BRIGHT << _("--jobs ") << NORMAL << PARAM << _("N") << NORMAL << _("] [")
+									   << BRIGHT << _("--incremental") << NORMAL << _("] [")
+									   << BRIGHT << _("--zip ") << NORMAL << PARAM << _("ZIPFILE") << NORMAL << _("] [")
+									   << BRIGHT << _("--sheets ") << NORMAL << PARAM << _("COLUMNSxROWS") << NORMAL << _("] [")
+									   << BRIGHT << _("--png-compression ") << NORMAL << PARAM << _("0-9") << NORMAL << _("] [")
+									   << BRIGHT << _("--png-filter ") << NORMAL << PARAM << _("FILTER") << NORMAL << _("]");
 					cli << _("\n         \tExport the cards in a set to image files,");
 					cli << _("\n         \tIMAGE is the same format as for 'export all card images'.");
+					cli << _("\n         \tUse ") << BRIGHT << _("--jobs") << NORMAL << _(" to set the number of threads that write the images,");
+					cli << _("\n         \tthe default is one per processor.");
+					cli << _("\n         \tWith ") << BRIGHT << _("--incremental") << NORMAL << _(", cards that have not changed since the last export to the same");
+					cli << _("\n         \tdirectory are skipped. Fingerprints of the cards are kept in a manifest file there.");
+					cli << _("\n         \tWith ") << BRIGHT << _("--zip") << NORMAL << _(", the images are written to a single zip file instead.");
+					cli << _("\n         \tWith ") << BRIGHT << _("--sheets") << NORMAL << _(", the cards are combined into sprite sheets sheet1.png, sheet2.png, ...");
+					cli << _("\n         \tand sheets.json lists the position of each card on the sheets.");
+					cli << _("\n         \tPNG images are compressed with zlib level ") << BRIGHT << _("--png-compression") << NORMAL << _(", 0 is fastest but not compressed");
+					cli << _("\n         \tand 9 is smallest, the default is 6. ") << BRIGHT << _("--png-filter") << NORMAL << _(" is one of none, sub, up, average, paeth");
+					cli << _("\n         \tor adaptive (the default).");
 					cli << _("\n\n  ") << BRIGHT << _("--cli") << NORMAL << _(" [")
 									   << BRIGHT << _("--quiet") << NORMAL << _("] [")
 									   << BRIGHT << _("--raw") << NORMAL << _("] [")
@@ -243,13 +276,57 @@ int MSE::OnRun() {
 					}
 					return EXIT_SUCCESS;
 				} else if (args[0] == _("--export-images")) {
-					if (args.size() < 2) {
+					// options
+					vector<String> files;
+					ExportImagesOptions options;
+					for (size_t i = 1 ; i < args.size() ; ++i) {
+						if ((args[i] == _("-j") || args[i] == _("--jobs")) && i+1 < args.size()) {
+							long jobs;
+							if (!args[i+1].ToLong(&jobs) || jobs < 1) {
+								throw Error(_("Invalid number of jobs: ") + args[i+1]);
+							}
+							options.jobs = (int)jobs;
+							++i;
+						} else if (args[i] == _("--incremental")) {
+							options.incremental = true;
+						} else if (args[i] == _("--zip") && i+1 < args.size()) {
+							options.archive = args[i+1];
+							++i;
+						} else if (args[i] == _("--sheets") && i+1 < args.size()) {
+							long columns, rows;
+							if (!args[i+1].BeforeFirst(_('x')).ToLong(&columns) || columns < 1 ||
+							    !args[i+1].AfterFirst(_('x')).ToLong(&rows)     || rows    < 1) {
+								throw Error(_("Invalid sprite sheet size, expected COLUMNSxROWS: ") + args[i+1]);
+							}
+							options.sheet_columns = (int)columns;
+							options.sheet_rows    = (int)rows;
+							++i;
+						} else if (args[i] == _("--png-compression") && i+1 < args.size()) {
+							long level;
+							if (!args[i+1].ToLong(&level) || level < 0 || level > 9) {
+								throw Error(_("Invalid PNG compression level, expected 0 to 9: ") + args[i+1]);
+							}
+							options.png.compression = (int)level;
+							++i;
+						} else if (args[i] == _("--png-filter") && i+1 < args.size()) {
+							if (!parse_png_filter(args[i+1], options.png.filter)) {
+								throw Error(_("Invalid PNG filter: ") + args[i+1]);
+							}
+							++i;
+						} else {
+							files.push_back(args[i]);
+						}
+					}
+					if (files.empty()) {
 						throw Error(_("No input file specified for --export-images"));
 					}
-					SetP set = import_set(args[1]);
+					if (options.incremental && (!options.archive.empty() || options.sheet_columns > 0)) {
+						throw Error(_("--incremental can not be combined with --zip or --sheets"));
+					}
+					SetP set = import_set(files[0]);
 					// path
-					String out = args.size() >= 3
-							   ? args[2]
+					String out = files.size() >= 2
+							   ? files[1]
 							   : settings.gameSettingsFor(*set->game).images_export_filename;
 					String path = _(".");
 					size_t pos = out.find_last_of(_("/\\"));
@@ -260,7 +337,10 @@ int MSE::OnRun() {
 						out  = out.substr(pos + 1);
 					}
 					// export
-					export_images(set, set->cards, path, out, CONFLICT_NUMBER_OVERWRITE);
+					CLIExportProgress progress;
+					options.conflicts = CONFLICT_NUMBER_OVERWRITE;
+					options.progress  = &progress;
+					export_images(set, set->cards, path, out, options);
 					return EXIT_SUCCESS;
 				} else if (args[0] == _("--export")) {
 					if (args.size() < 2) {
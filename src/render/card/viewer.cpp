@@ -16,14 +16,13 @@
 #include <data/settings.hpp>
 #include <data/action/value.hpp>
 #include <data/action/set.hpp>
-#include <gui/util.hpp> // clearDC
 
 DECLARE_TYPEOF_COLLECTION(ValueViewerP);
 DECLARE_TYPEOF_NO_REV(IndexMap<FieldP COMMA StyleP>);
 
 // ----------------------------------------------------------------------------- : DataViewer
 
-DataViewer::DataViewer() {}
+DataViewer::DataViewer() : layer_offscreen(false) {}
 DataViewer::~DataViewer() {}
 
 // ----------------------------------------------------------------------------- : Drawing
@@ -31,16 +30,23 @@ DataViewer::~DataViewer() {}
 IMPLEMENT_DYNAMIC_ARG(bool, drawing_card, false);
 
 void DataViewer::draw(DC& dc) {
-	StyleSheetSettings& ss = settings.stylesheetSettingsFor(*stylesheet);
-	RotatedDC rdc(dc, getRotation(),
-	              nativeLook() ? QUALITY_LOW : (ss.card_anti_alias() ? QUALITY_AA : QUALITY_SUB_PIXEL));
+	RotatedDC rdc(dc, getRotation(), renderQuality());
+	draw(rdc, stylesheet->card_background);
+}
+void DataViewer::draw(SoftwareCanvas& canvas) {
+	RotatedDC rdc(canvas, getRotation());
 	draw(rdc, stylesheet->card_background);
 }
+RenderQuality DataViewer::renderQuality() const {
+	if (nativeLook()) return QUALITY_LOW;
+	StyleSheetSettings& ss = settings.stylesheetSettingsFor(*stylesheet);
+	return ss.card_anti_alias() ? QUALITY_AA : QUALITY_SUB_PIXEL;
+}
 void DataViewer::draw(RotatedDC& dc, const Color& background) {
 	if (!set) return; // no set specified, don't draw anything
 	WITH_DYNAMIC_ARG(drawing_card, true);
 	// fill with background color
-	clearDC(dc.getDC(), background);
+	dc.Clear(background);
 	// update style scripts
 	updateStyles(false);
 	// prepare viewers
@@ -60,14 +66,39 @@ void DataViewer::draw(RotatedDC& dc, const Color& background) {
 	if (changed_content_properties) {
 		updateStyles(true);
 	}
+	// the static viewers at the bottom can be drawn from the layer cache
+	vector<LayerViewer> candidates;
+	layerViewers(candidates);
+	size_t in_layer = 0; // number of visible viewers drawn from the layer
+	if (canUseLayer(dc, background, candidates)) {
+		in_layer = layer_viewers.size();
+		if (dc.isOffscreen()) {
+			dc.DrawPreRotatedImage(layer_image, dc.getInternalRect(), COMBINE_NORMAL);
+		} else {
+			dc.DrawPreRotatedBitmap(layer_bitmap, dc.getInternalRect());
+		}
+	} else {
+		clearLayerCache();
+	}
+	// only store the layer if all of it is actually drawn
+	bool store_layer = candidates.size() > in_layer && !isPartialDraw();
 	// draw viewers
+	size_t visible = 0;
 	FOR_EACH(v, viewers) { // draw low z index fields first
 		if (v->getStyle()->isVisible()) {// visible
-			Rotater r(dc, v->getRotation());
-			try {
-				drawViewer(dc, *v);
-			} catch (const Error& e) {
-				handle_error(e);
+			v->drawn_box = v->boundingBox();
+			if (visible++ < in_layer) continue;
+			{
+				Rotater r(dc, v->getRotation());
+				try {
+					drawViewer(dc, *v);
+				} catch (const Error& e) {
+					handle_error(e);
+					store_layer = false;
+				}
+			}
+			if (store_layer && visible == candidates.size()) {
+				storeLayer(dc, background, candidates);
 			}
 		}
 	}
@@ -76,6 +107,64 @@ void DataViewer::drawViewer(RotatedDC& dc, ValueViewer& v) {
 	v.draw(dc);
 }
 
+// ----------------------------------------------------------------------------- : Layer cache
+
+void DataViewer::layerViewers(vector<LayerViewer>& out) const {
+	if (nativeLook()) return; // native controls are cheap to draw, and depend on the focus
+	FOR_EACH_CONST(v, viewers) {
+		if (!v->getStyle()->isVisible()) continue;
+		if (!v->isStatic() || v->isCurrent()) break;
+		LayerViewer l = { v.get(), drawWhat(v.get()) };
+		out.push_back(l);
+	}
+}
+
+/// Is the same transformation used for both rotations?
+bool same_rotation(const Rotation& a, const Rotation& b) {
+	RealPoint oa = a.tr(RealPoint(0,0)), ob = b.tr(RealPoint(0,0));
+	RealSize  sa = a.getInternalSize(),  sb = b.getInternalSize();
+	return a.getAngle() == b.getAngle() && a.getZoom() == b.getZoom() && a.getStretch() == b.getStretch()
+	    && oa.x == ob.x && oa.y == ob.y && sa.width == sb.width && sa.height == sb.height;
+}
+
+bool DataViewer::canUseLayer(RotatedDC& dc, const Color& background, const vector<LayerViewer>& candidates) const {
+	if (layer_viewers.empty() || layer_viewers.size() > candidates.size()) return false;
+	if (layer_offscreen != dc.isOffscreen() || layer_background != background) return false;
+	if (!same_rotation(layer_rotation, dc)) return false;
+	return equal(layer_viewers.begin(), layer_viewers.end(), candidates.begin());
+}
+
+void DataViewer::storeLayer(RotatedDC& dc, const Color& background, const vector<LayerViewer>& viewers) {
+	layer_viewers    = viewers;
+	layer_rotation   = dc;
+	layer_background = background;
+	layer_offscreen  = dc.isOffscreen();
+	if (layer_offscreen) {
+		layer_image  = dc.GetBackgroundImage(dc.getInternalRect());
+		layer_bitmap = Bitmap();
+	} else {
+		layer_bitmap = dc.GetBackground(dc.getInternalRect());
+		layer_image  = Image();
+	}
+}
+
+void DataViewer::clearLayerCache() {
+	layer_viewers.clear();
+	layer_bitmap = Bitmap();
+	layer_image  = Image();
+}
+
+void DataViewer::invalidateLayer(const ValueViewer& v) {
+	for (size_t i = 0 ; i < layer_viewers.size() ; ++i) {
+		if (layer_viewers[i].viewer == &v) {
+			clearLayerCache();
+			return;
+		}
+	}
+}
+
+// ----------------------------------------------------------------------------- : Style scripts
+
 void DataViewer::updateStyles(bool only_content_dependent) {
 	try {
 		if (card) {
@@ -144,6 +233,7 @@ void DataViewer::setCard(const CardP& card, bool refresh) {
 }
 
 void DataViewer::onChangeSet() {
+	clearLayerCache();
 	viewers.clear();
 	onInit();
 	onChange();
@@ -165,6 +255,7 @@ void DataViewer::setStyles(const StyleSheetP& stylesheet, IndexMap<FieldP,StyleP
 	}
 	this->stylesheet = stylesheet;
 	// create viewers
+	clearLayerCache();
 	viewers.clear();
 	addStyles(styles);
 	if (extra_styles) addStyles(*extra_styles);
@@ -214,9 +305,10 @@ void DataViewer::onAction(const Action& action, bool undone) {
 		if (action.card == card.get()) {
 			FOR_EACH(v, viewers) {
 				if (v->getValue()->equals( action.valueP.get() )) {
-					// refresh the viewer
+					// refresh the viewer, only its area has to be redrawn
+					invalidateLayer(*v);
 					v->onAction(action, undone);
-					onChange();
+					redraw(*v);
 					return;
 				}
 			}
@@ -227,8 +319,9 @@ void DataViewer::onAction(const Action& action, bool undone) {
 			FOR_EACH(v, viewers) {
 				if (v->getValue().get() == action.value) {
 					// refresh the viewer
+					invalidateLayer(*v);
 					v->onAction(action, undone);
-					onChange();
+					redraw(*v);
 					return;
 				}
 			}
@@ -17,6 +17,7 @@
 DECLARE_POINTER_TYPE(Style);
 DECLARE_POINTER_TYPE(ValueViewer);
 class Context;
+class SoftwareCanvas;
 
 // ----------------------------------------------------------------------------- : DataViewer
 
@@ -34,6 +35,11 @@ class DataViewer : public SetView {
 	virtual void draw(DC& dc);
 	/// Draw the current (card/data) to the given dc
 	virtual void draw(RotatedDC& dc, const Color& background);
+	/// Draw the current (card/data) to an offscreen canvas, which should have the size of getRotation()
+	/** Text is always anti-aliased on a canvas, so this should only be used when renderQuality() == QUALITY_AA */
+	void draw(SoftwareCanvas& canvas);
+	/// The quality with which draw(DC&) draws, depends on nativeLook and the stylesheet settings
+	RenderQuality renderQuality() const;
 	/// Draw a single viewer
 	virtual void drawViewer(RotatedDC& dc, ValueViewer& v);
 	
@@ -55,6 +61,8 @@ class DataViewer : public SetView {
 	inline const CardP& getCard() const { return card; }
 	/// Invalidate and redraw (the area of) a single value viewer
 	virtual void redraw(const ValueViewer&) {}
+	/// Notification that a viewer will look different, so it can't be drawn from the layer cache
+	void invalidateLayer(const ValueViewer&);
 	
 	/// The package containing style stuff like images
 	virtual Package& getStylePackage() const;
@@ -98,9 +106,44 @@ class DataViewer : public SetView {
 	/// Notification that the size of the viewer may have changed
 	virtual void onChangeSize() {}
 	
+	/// Is only part of the viewer being redrawn?
+	/** The cached background layer can then still be drawn, but it can't be updated */
+	virtual bool isPartialDraw() const { return false; }
+	/// Discard the cached background layer
+	void clearLayerCache();
+	
 	vector<ValueViewerP> viewers;	///< The viewers for the different values in the data
 	CardP card;						///< The card that is currently displayed, if any
 	mutable StyleSheetP stylesheet;	///< Stylesheet being used
+	
+  private:
+	// --------------------------------------------------- : Layer cache
+	
+	/// A viewer that is drawn in the background layer, and how it was drawn
+	struct LayerViewer {
+		const ValueViewer* viewer;
+		DrawWhat           what;
+		inline bool operator == (const LayerViewer& that) const {
+			return viewer == that.viewer && what == that.what;
+		}
+	};
+	/** The visible viewers at the bottom of the z-order that are static (see ValueViewer::isStatic)
+	 *  are drawn once, and the result is kept as a background layer.
+	 *  When the card is redrawn only the viewers above that layer are drawn again.
+	 */
+	vector<LayerViewer> layer_viewers;	///< Viewers drawn in the layer, in z-order; empty if there is no layer
+	Bitmap              layer_bitmap;	///< The layer, when drawing to a DC
+	Image               layer_image;	///< The layer, when drawing offscreen
+	Rotation            layer_rotation;	///< Rotation the layer was drawn with
+	Color               layer_background;
+	bool                layer_offscreen;
+	
+	/// Find the viewers that can be drawn in the background layer
+	void layerViewers(vector<LayerViewer>& out) const;
+	/// Can the cached layer be used for drawing on dc?
+	bool canUseLayer(RotatedDC& dc, const Color& background, const vector<LayerViewer>& candidates) const;
+	/// Store the current contents of dc as the background layer
+	void storeLayer(RotatedDC& dc, const Color& background, const vector<LayerViewer>& viewers);
 };
 
 // ----------------------------------------------------------------------------- : EOF
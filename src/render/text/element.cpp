@@ -15,6 +15,24 @@
 DECLARE_TYPEOF_COLLECTION(TextElementP);
 DECLARE_POINTER_TYPE(FontTextElement);
 
+// ----------------------------------------------------------------------------- : LineBreakTable
+
+void LineBreakTable::init(const vector<CharInfo>& chars, bool multi_line, bool vertical) {
+	size_t n = chars.size();
+	forced  .assign(n, false);
+	word_end.assign(n, false);
+	space   .assign(n, false);
+	for (size_t i = 0 ; i < n ; ++i) {
+		LineBreak b = chars[i].break_after;
+		if (b == BREAK_SOFT || b == BREAK_HARD || b == BREAK_LINE || (b == BREAK_MAYBE && vertical)) {
+			forced[i] = true;
+		} else if (b == BREAK_SPACE) {
+			space[i]    = true;
+			word_end[i] = multi_line;
+		}
+	}
+}
+
 // ----------------------------------------------------------------------------- : TextElements
 
 void TextElements::draw(RotatedDC& dc, double scale, const RealRect& rect, const double* xs, DrawWhat what, size_t start, size_t end) const {
@@ -194,11 +212,12 @@ struct TextElementsFromString {
   private:
 	/// Create a text element for a piece of text, text[start..end)
 	void addText(TextElements& te, const String& text, size_t start, size_t end, const TextStyle& style, Context& ctx) {
-		String content = untag(text.substr(start, end - start));
-		assert(content.size() == end-start);
+		// the elements for this piece of text all point to the same content
+		shared_ptr<String> content = shared(new String(untag(text.substr(start, end - start))));
+		assert(content->size() == end-start);
 		// use symbol font?
 		if (symbol > 0 && style.symbol_font.valid()) {
-			te.elements.push_back(intrusive(new SymbolTextElement(content, start, end, style.symbol_font, &ctx)));
+			te.elements.push_back(intrusive(new SymbolTextElement(content, 0, start, end, style.symbol_font, &ctx)));
 		} else {
 			// text, possibly mixed with symbols
 			DrawWhat what = soft > 0 ? DRAW_ACTIVE : DRAW_NORMAL;
@@ -206,7 +225,7 @@ struct TextElementsFromString {
 			                       soft_line > 0 ? BREAK_SOFT : BREAK_HARD;
 			if (kwpph > 0 || param > 0) {
 				// bracket the text
-				content = String(LEFT_ANGLE_BRACKET) + content + RIGHT_ANGLE_BRACKET;
+				*content = String(LEFT_ANGLE_BRACKET) + *content + RIGHT_ANGLE_BRACKET;
 				start -= 1;
 				end   += 1;
 			}
@@ -216,14 +235,14 @@ struct TextElementsFromString {
 				size_t pos = 0;
 				FontP font;
 				while (pos < end-start) {
-					if (size_t n = style.symbol_font.font->recognizePrefix(content,pos)) {
+					if (size_t n = style.symbol_font.font->recognizePrefix(*content,pos)) {
 						// at 'pos' there are n symbol font characters
 						if (text_pos < pos) {
 							// text before it?
 							if (!font) font = makeFont(style);
-							te.elements.push_back(intrusive(new FontTextElement(content.substr(text_pos, pos-text_pos), start+text_pos, start+pos, font, what, line_break)));
+							te.elements.push_back(intrusive(new FontTextElement(content, text_pos, start+text_pos, start+pos, font, what, line_break)));
 						}
-						te.elements.push_back(intrusive(new SymbolTextElement(content.substr(pos,n), start+pos, start+pos+n, style.symbol_font, &ctx)));
+						te.elements.push_back(intrusive(new SymbolTextElement(content, pos, start+pos, start+pos+n, style.symbol_font, &ctx)));
 						text_pos = pos += n;
 					} else {
 						++pos;
@@ -231,10 +250,10 @@ struct TextElementsFromString {
 				}
 				if (text_pos < pos) {
 					if (!font) font = makeFont(style);
-					te.elements.push_back(intrusive(new FontTextElement(content.substr(text_pos), start+text_pos, end, font, what, line_break)));
+					te.elements.push_back(intrusive(new FontTextElement(content, text_pos, start+text_pos, end, font, what, line_break)));
 				}
 			} else {
-				te.elements.push_back(intrusive(new FontTextElement(content, start, end, makeFont(style), what, line_break)));
+				te.elements.push_back(intrusive(new FontTextElement(content, 0, start, end, makeFont(style), what, line_break)));
 			}
 		}
 	}
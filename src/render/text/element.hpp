@@ -47,6 +47,29 @@ struct CharInfo {
 	{}
 };
 
+/// The line break opportunities in a sequence of characters
+/** Line breaks do not depend on the scale of the text,
+ *  so they are determined once for a prepared text, and used for all scales and alignment passes.
+ */
+class LineBreakTable {
+  public:
+	/// Find the line breaks
+	/** If multi_line, then spaces end words where the line can be broken.
+	 *  If vertical, then BREAK_MAYBE always breaks the line.
+	 */
+	void init(const vector<CharInfo>& chars, bool multi_line, bool vertical);
+	
+	/// Must the line be broken after character i?
+	inline bool forcedAfter(size_t i)  const { return forced[i]; }
+	/// Does a word end after character i, so the line can be broken there?
+	inline bool wordEndAfter(size_t i) const { return word_end[i]; }
+	/// Is character i a space (BREAK_SPACE), for justification?
+	inline bool spaceAt(size_t i)      const { return space[i]; }
+	
+  private:
+	vector<bool> forced, word_end, space;
+};
+
 /// A section of text that can be rendered using a TextViewer
 class TextElement : public IntrusivePtrBase<TextElement> {
   public:
@@ -98,19 +121,32 @@ class TextElements {
 // ----------------------------------------------------------------------------- : SimpleTextElement
 
 /// A text element that just shows text
+/** The text is (*content)[offset .. offset+end-start). The elements made from one piece of text
+ *  point to the same content string, instead of each having their own copy of (a substring of) it.
+ */
 class SimpleTextElement : public TextElement {
   public:
-	SimpleTextElement(const String& content, size_t start, size_t end)
-		: TextElement(start, end), content(content)
+	SimpleTextElement(const shared_ptr<const String>& content, size_t offset, size_t start, size_t end)
+		: TextElement(start, end), content(content), offset(offset)
 	{}
-	String content;	///< Text to show
+	shared_ptr<const String> content;	///< Text to show (and possibly more)
+	size_t                   offset;	///< Position in content of the start of this element
+	
+	/// The character at index i of the input string, this->start <= i < this->end
+	inline Char charAt(size_t i) const {
+		return content->GetChar(offset + i - this->start);
+	}
+	/// The text in the range [start..end) of the input string
+	inline String substring(size_t start, size_t end) const {
+		return content->substr(offset + start - this->start, end - start);
+	}
 };
 
 /// A text element that uses a normal font
 class FontTextElement : public SimpleTextElement {
   public:
-	FontTextElement(const String& content, size_t start, size_t end, const FontP& font, DrawWhat draw_as, LineBreak break_style)
-		: SimpleTextElement(content, start, end)
+	FontTextElement(const shared_ptr<const String>& content, size_t offset, size_t start, size_t end, const FontP& font, DrawWhat draw_as, LineBreak break_style)
+		: SimpleTextElement(content, offset, start, end)
 		, font(font), draw_as(draw_as), break_style(break_style)
 	{}
 	
@@ -127,8 +163,8 @@ class FontTextElement : public SimpleTextElement {
 /// A text element that uses a symbol font
 class SymbolTextElement : public SimpleTextElement {
   public:
-	SymbolTextElement(const String& content, size_t start, size_t end, const SymbolFontRef& font, Context* ctx)
-		: SimpleTextElement(content, start, end)
+	SymbolTextElement(const shared_ptr<const String>& content, size_t offset, size_t start, size_t end, const SymbolFontRef& font, Context* ctx)
+		: SimpleTextElement(content, offset, start, end)
 		, font(font), ctx(*ctx)
 	{}
 	
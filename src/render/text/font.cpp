@@ -15,7 +15,7 @@
 void FontTextElement::draw(RotatedDC& dc, double scale, const RealRect& rect, const double* xs, DrawWhat what, size_t start, size_t end) const {
 	if ((what & draw_as) != draw_as) return; // don't draw
 	// text
-	String text = content.substr(start - this->start, end - start);
+	String text = substring(start, end);
 	if (!text.empty() && text.GetChar(text.size() - 1) == _('\n')) {
 		text = text.substr(0, text.size() - 1); // don't draw last \n
 	}
@@ -29,15 +29,16 @@ void FontTextElement::getCharInfo(RotatedDC& dc, double scale, vector<CharInfo>&
 	dc.SetFont(*font, scale);
 	// find sizes & breaks
 	double prev_width = 0;
-	size_t line_start = start; // start of the current line
+	String line_text; // text of the current line so far, grown one character at a time
 	for (size_t i = start ; i < end ; ++i) {
-		Char c = content.GetChar(i - this->start);
+		Char c = charAt(i);
 		if (c == _('\n')) {
 			out.push_back(CharInfo(RealSize(0, dc.GetCharHeight()), break_style, draw_as == DRAW_ACTIVE));
-			line_start = i + 1;
+			line_text.clear();
 			prev_width = 0;
 		} else {
-			RealSize s = dc.GetTextExtent(content.substr(line_start - this->start, i - line_start + 1));
+			line_text += c;
+			RealSize s = dc.GetTextExtent(line_text);
 			out.push_back(CharInfo(
 			                 RealSize(s.width - prev_width, s.height),
 			                 c == _(' ') ? BREAK_SPACE : BREAK_MAYBE,
@@ -50,7 +50,7 @@ struct TextViewer::Line {
 	RealRect selectionRectangle(const Rotation& rot, size_t start, size_t end);
 	
 	/// Align the contents of this line *horizontally* inside the given rectangle
-	void alignHorizontal(const vector<CharInfo>& chars, const TextStyle& style, const RealRect& s);
+	void alignHorizontal(const LineBreakTable& breaks, const TextStyle& style, const RealRect& s);
 };
 
 size_t TextViewer::Line::posToIndex(double x) const {
@@ -348,7 +348,8 @@ void TextViewer::prepareElements(const String& text, const TextStyle& style, Con
 // ----------------------------------------------------------------------------- : Layout
 
 void TextViewer::prepareLines(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx) {
-	vector<CharInfo> chars;
+	chars.clear();
+	chars.reserve(text.size());
 	prepareLinesTryScales(dc, text, style, chars);
 	assert(!lines.empty());
 	
@@ -376,7 +377,7 @@ void TextViewer::prepareLines(RotatedDC& dc, const String& text, TextStyle& styl
 	}
 	
 	// align
-	alignLines(dc, chars, style);
+	alignLines(dc, style);
 	
 	// HACK : fix empty first line before <line>, do this after align, so layout is not affected
 	if (lines.size() > 1 && lines[0].line_height == 0) {
@@ -404,15 +405,16 @@ inline double bound_on_min_scale(RotatedDC& dc, const TextStyle& style, const ve
 	return scale * tot_height / height;
 }
 
-void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const TextStyle& style, vector<CharInfo>& chars) {
+void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const TextStyle& style, vector<CharInfo>& chars_out) {
 	// Bounds
 	double min_scale = elements.minScale();
 	double scale_step = max(0.01,elements.scaleStep());
 	// Is there any scaling (common case is: no)
 	if (min_scale >= 1.0) {
 		scale = 1.0;
-		elements.getCharInfo(dc, scale, 0, text.size(), chars);
-		prepareLinesScale(dc, chars, style, false, lines);
+		elements.getCharInfo(dc, scale, 0, text.size(), chars_out);
+		breaks.init(chars_out, style.field().multi_line, style.direction == TOP_TO_BOTTOM);
+		prepareLinesScale(dc, chars_out, style, false, lines);
 		return;
 	}
 	
@@ -433,8 +435,10 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
 	//           - change max_scale	
 	
 	// Try the layout at the previous scale, this could give a quick upper bound
-	elements.getCharInfo(dc, scale, 0, text.size(), chars);
-	bool fits = prepareLinesScale(dc, chars, style, false, lines);
+	elements.getCharInfo(dc, scale, 0, text.size(), chars_out);
+	// the line breaks are the same for all scales
+	breaks.init(chars_out, style.field().multi_line, style.direction == TOP_TO_BOTTOM);
+	bool fits = prepareLinesScale(dc, chars_out, style, false, lines);
 	if (fits) {
 		min_scale = scale;
 		max_scale = min(max_scale, bound_on_max_scale(dc,style,lines,scale));
@@ -442,14 +446,13 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
 		if (scale + scale_step >= max_scale) return;
 		// try just before
 		scale += scale_step;
-		vector<Line> lines_before;
-		vector<CharInfo> chars_before;
-		elements.getCharInfo(dc, scale, 0, text.size(), chars_before);
-		fits = prepareLinesScale(dc, chars_before, style, false, lines_before);
+		chars_try.clear();
+		elements.getCharInfo(dc, scale, 0, text.size(), chars_try);
+		fits = prepareLinesScale(dc, chars_try, style, false, lines_try);
 		if (fits) {
 			// too bad
-			swap(lines, lines_before);
-			swap(chars, chars_before);
+			swap(lines, lines_try);
+			swap(chars_out, chars_try);
 			best_scale = min_scale = scale;
 			max_scale = min(max_scale, bound_on_max_scale(dc,style,lines,scale));
 		} else {
@@ -462,9 +465,9 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
 		min_scale = max(min_scale, bound_on_min_scale(dc,style,lines,scale));
 		// ensure invariant d (below)
 		best_scale = scale = min_scale;
-		chars.clear();
-		elements.getCharInfo(dc, scale, 0, text.size(), chars);
-		prepareLinesScale(dc, chars, style, false, lines);
+		chars_out.clear();
+		elements.getCharInfo(dc, scale, 0, text.size(), chars_out);
+		prepareLinesScale(dc, chars_out, style, false, lines);
 		max_scale = min(max_scale, bound_on_max_scale(dc,style,lines,scale));
 	}
 	
@@ -473,14 +476,13 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
 	//    a. The text fits at min_scale (or we force it anyway)
 	//    b. but not at max_scale
 	//    c. 0 < min_scale <= real_scale < max_scale <= 1.0+epsilon
-	//    d. lines and chars give the best fitting positioning, at best_scale
+	//    d. lines and chars_out give the best fitting positioning, at best_scale
 	//    try: e. min_scale <= best_scale
 		
 	// go binary search!
 	while(min_scale + scale_step < max_scale) {
 		scale = (min_scale + max_scale) / 2;
-		vector<Line> lines_try;
-		vector<CharInfo> chars_try;
+		chars_try.clear();
 		elements.getCharInfo(dc, scale, 0, text.size(), chars_try);
 		fits = prepareLinesScale(dc, chars_try, style, false, lines_try);
 		if (fits) {
@@ -488,7 +490,7 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
 			max_scale = min(max_scale, bound_on_max_scale(dc,style,lines_try,scale));
 			best_scale = scale; // invariant d
 			swap(lines,lines_try); 
-			swap(chars,chars_try);
+			swap(chars_out,chars_try);
 		} else {
 			max_scale = scale;
 			min_scale = max(min_scale, bound_on_min_scale(dc,style,lines_try,scale));
@@ -498,9 +500,9 @@ void TextViewer::prepareLinesTryScales(RotatedDC& dc, const String& text, const
 	if (best_scale != min_scale) {
 		// we'd better update lines, e doesn't hold
 		scale = min_scale;
-		chars.clear();
-		elements.getCharInfo(dc, scale, 0, text.size(), chars);
-		fits = prepareLinesScale(dc, chars, style, false, lines);
+		chars_out.clear();
+		elements.getCharInfo(dc, scale, 0, text.size(), chars_out);
+		fits = prepareLinesScale(dc, chars_out, style, false, lines);
 	}
 	scale = min_scale;
 }
@@ -533,18 +535,19 @@ bool TextViewer::prepareLinesScale(RotatedDC& dc, const vector<CharInfo>& chars,
 		bool break_now     = false;
 		bool accept_word   = false; // the current word should be added to the line
 		bool hide_breaker  = true;  // hide the \n or _(' ') that caused a line break
-		if (c.break_after == BREAK_SOFT || c.break_after == BREAK_HARD || c.break_after == BREAK_LINE) {
+		if (breaks.forcedAfter(i)) {
 			break_now   = true;
 			accept_word = true;
-			line.break_after = c.break_after;
-		} else if (c.break_after == BREAK_SPACE && style.field().multi_line) {
+			if (c.break_after == BREAK_MAYBE) {
+				// vertical text
+				hide_breaker = false;
+				line.break_after = BREAK_SOFT;
+			} else {
+				line.break_after = c.break_after;
+			}
+		} else if (breaks.wordEndAfter(i)) {
 			// Soft break == end of word
 			accept_word = true;
-		} else if (c.break_after == BREAK_MAYBE && style.direction == TOP_TO_BOTTOM) {
-			break_now   = true;
-			accept_word = true;
-			hide_breaker = false;
-			line.break_after = BREAK_SOFT;
 		}
 		// Add size of the character
 		if (c.break_after != BREAK_LINE) {
@@ -677,7 +680,7 @@ double TextViewer::lineRight(RotatedDC& dc, const TextStyle& style, double y) co
 }
 
 
-void TextViewer::alignLines(RotatedDC& dc, const vector<CharInfo>& chars, const TextStyle& style) {
+void TextViewer::alignLines(RotatedDC& dc, const TextStyle& style) {
 	// Size of the box
 	RealSize s = add_diagonal(
 					dc.getInternalSize(),
@@ -686,14 +689,14 @@ void TextViewer::alignLines(RotatedDC& dc, const vector<CharInfo>& chars, const
 		// whole text box alignment
 		assert(!lines.empty());
 		double top = lines[0].top;
-		alignParagraph(0, lines.size(), chars, style, RealRect(RealPoint(0,top),s));
+		alignParagraph(0, lines.size(), style, RealRect(RealPoint(0,top),s));
 	} else {
 		// per paragraph alignment
 		size_t start = 0;
 		int n = 0;
 		for (size_t last = 0 ; last < lines.size() ; ++last) {
 			if (lines[last].break_after != BREAK_SOFT || last == lines.size()) {
-				alignParagraph(start, last + 1, chars, style, RealRect(0, style.padding_top+n*style.paragraph_height, s.width, style.paragraph_height));
+				alignParagraph(start, last + 1, style, RealRect(0, style.padding_top+n*style.paragraph_height, s.width, style.paragraph_height));
 				start = last + 1;
 				++n;
 			}
@@ -701,7 +704,7 @@ void TextViewer::alignLines(RotatedDC& dc, const vector<CharInfo>& chars, const
 	}
 }
 
-void TextViewer::alignParagraph(size_t start_line, size_t end_line, const vector<CharInfo>& chars, const TextStyle& style, const RealRect& s) {
+void TextViewer::alignParagraph(size_t start_line, size_t end_line, const TextStyle& style, const RealRect& s) {
 	if (start_line >= end_line) return;
 	
 	// Find height of the text, don't count the last lines if they are empty
@@ -762,12 +765,12 @@ void TextViewer::alignParagraph(size_t start_line, size_t end_line, const vector
 		l.top += vdelta;
 		// amount to shift all characters horizontally
 		l.alignment = style.alignment; // TODO: set at another place
-		l.alignHorizontal(chars, style, s);
+		l.alignHorizontal(breaks, style, s);
 	}
 	// TODO : work well with mask
 }
 
-void TextViewer::Line::alignHorizontal(const vector<CharInfo>& chars, const TextStyle& style, const RealRect& s) {
+void TextViewer::Line::alignHorizontal(const LineBreakTable& breaks, const TextStyle& style, const RealRect& s) {
 	double width = this->width();
 	bool should_fill = (alignment & ALIGN_IF_OVERFLOW  ? width > s.width : true)
 	                && (alignment & ALIGN_IF_SOFTBREAK ? break_after == BREAK_SOFT || !style.field().multi_line : true);
@@ -787,13 +790,13 @@ void TextViewer::Line::alignHorizontal(const vector<CharInfo>& chars, const Text
 		double hdelta = s.width - width; // amount of space to distribute
 		int count = 0;                   // distribute it among this many word breaks
 		for (size_t k = start + 1 ; k < end_or_soft - 1 ; ++k) {
-			if (chars[k].break_after == BREAK_SPACE) ++count;
+			if (breaks.spaceAt(k)) ++count;
 		}
 		if (count == 0) count = 1;       // prevent div by 0
 		int i = 0; size_t j = start;
 		FOR_EACH(c, positions) {
 			c += s.x + hdelta * i / count;
-			if (j < end_or_soft && chars[j++].break_after == BREAK_SPACE) i++;
+			if (j < end_or_soft && breaks.spaceAt(j++)) i++;
 		}
 	} else if ((alignment & ALIGN_STRETCH) && should_fill) {
 		// stretching, don't center or align right
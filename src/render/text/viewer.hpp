@@ -132,19 +132,25 @@ class TextViewer {
 	void prepareElements(const String&, const TextStyle& style, Context& ctx);
 	
 	// --------------------------------------------------- : Lines
-	vector<Line> lines; ///< The lines in the text box
+	vector<Line>   lines;  ///< The lines in the text box
+	LineBreakTable breaks; ///< Line break opportunities in the prepared text
+	// buffers that are reused between prepares, to avoid allocating them each time
+	vector<CharInfo> chars;     ///< Information on the characters, at the current scale
+	vector<CharInfo> chars_try; ///< Information on the characters, at a scale that is being tried
+	vector<Line>     lines_try; ///< Layout at a scale that is being tried
 	
 	/// Prepare the lines, layout the text
 	void prepareLines(RotatedDC& dc, const String& text, TextStyle& style, Context& ctx);
 	/// Find the scale to use for the text
 	void prepareLinesTryScales(RotatedDC& dc, const String& text, const TextStyle& style, vector<CharInfo>& chars_out);
 	/// Prepare the lines, layout the text; at a specific scale
-	/** Stores output in lines_out */
+	/** Stores output in lines_out.
+	 *  Uses the line breaks from breaks, which must be initialized for chars */
 	bool prepareLinesScale(RotatedDC& dc, const vector<CharInfo>& chars, const TextStyle& style, bool stop_if_too_long, vector<Line>& lines_out) const;
 	/// Align the lines within the textbox
-	void alignLines(RotatedDC& dc, const vector<CharInfo>& chars, const TextStyle& style);
+	void alignLines(RotatedDC& dc, const TextStyle& style);
 	/// Align the lines of a single paragraph (a set of lines)
-	void alignParagraph(size_t start_line, size_t end_line, const vector<CharInfo>& chars, const TextStyle& style, const RealRect& box);
+	void alignParagraph(size_t start_line, size_t end_line, const TextStyle& style, const RealRect& box);
 	
 	/// Find the line the given index is on, returns the first line if the index is not found
 	const Line& findLine(size_t index) const;
@@ -59,10 +59,10 @@ void ColorValueViewer::draw(RotatedDC& dc) {
 					style().width  - style().left_width - style().right_width,
 					style().height - style().top_width  - style().bottom_width
 				)));
-				dc.getDC().SetClippingRegion(r);
+				dc.SetClippingRegion(r);
 			}
 			dc.DrawRoundedRectangle(style().getInternalRect(), style().radius);
-			if (clip) dc.getDC().DestroyClippingRegion();
+			if (clip) dc.DestroyClippingRegion();
 		}
 		drawFieldBorder(dc);
 	}
@@ -23,6 +23,7 @@ class ImageValueViewer : public ValueViewer {
 	DECLARE_VALUE_VIEWER(Image) : ValueViewer(parent,style) {}
 	
 	virtual void draw(RotatedDC& dc);
+	virtual bool isStatic() const { return false; }
 	virtual void onValueChange();
 	virtual void onStyleChange(int);
 			
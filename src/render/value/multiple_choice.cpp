@@ -53,8 +53,20 @@ void MultipleChoiceValueViewer::draw(RotatedDC& dc) {
 void MultipleChoiceValueViewer::drawChoice(RotatedDC& dc, RealPoint& pos, const String& choice, bool active) {
 	RealSize size; size.height = item_height;
 	if (style().render_style & RENDER_CHECKLIST) {
-		wxRect rect = dc.trRectToBB(RealRect(pos + RealSize(1,1), RealSize(12,12)));
-		draw_checkbox(nullptr, dc.getDC(), rect, active); // TODO
+		if (dc.isOffscreen()) {
+			// there is no wx DC to draw a native checkbox on
+			RealRect rect(pos + RealSize(1,1), RealSize(12,12));
+			dc.SetPen(*wxBLACK_PEN);
+			dc.SetBrush(*wxTRANSPARENT_BRUSH);
+			dc.DrawRectangle(rect);
+			if (active) {
+				dc.DrawLine(rect.position() + RealSize(3,6), rect.position() + RealSize(5,9));
+				dc.DrawLine(rect.position() + RealSize(5,9), rect.position() + RealSize(10,3));
+			}
+		} else {
+			wxRect rect = dc.trRectToBB(RealRect(pos + RealSize(1,1), RealSize(12,12)));
+			draw_checkbox(nullptr, dc.getDC(), rect, active); // TODO
+		}
 		size = add_horizontal(size, RealSize(14,16));
 	}
 	if (style().render_style & RENDER_IMAGE) {
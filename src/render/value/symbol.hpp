@@ -21,6 +21,7 @@ class SymbolValueViewer : public ValueViewer {
 	DECLARE_VALUE_VIEWER(Symbol) : ValueViewer(parent,style) {}
 	
 	virtual void draw(RotatedDC& dc);
+	virtual bool isStatic() const { return false; }
 	void onValueChange();
 	
   protected:
@@ -23,6 +23,7 @@ class TextValueViewer : public ValueViewer {
 	
 	virtual bool prepare(RotatedDC& dc);
 	virtual void draw(RotatedDC& dc);
+	virtual bool isStatic() const { return false; }
 	virtual void onValueChange();
 	virtual void onStyleChange(int);
 	virtual void onAction(const Action&, bool undone);
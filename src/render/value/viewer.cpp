@@ -15,7 +15,7 @@ DECLARE_TYPEOF_COLLECTION(wxPoint);
 // ----------------------------------------------------------------------------- : ValueViewer
 
 ValueViewer::ValueViewer(DataViewer& parent, const StyleP& style)
-	: StyleListener(style), viewer(parent)
+	: StyleListener(style), viewer(parent), drawn_box(0,0,0,0)
 {}
 
 Package& ValueViewer::getStylePackage() const { return viewer.getStylePackage(); }
@@ -24,6 +24,10 @@ Package& ValueViewer::getLocalPackage() const { return viewer.getLocalPackage();
 void ValueViewer::setValue(const ValueP& value) {
 	assert(value->fieldP == styleP->fieldP); // matching field
 	if (valueP == value) return;
+	// a value that looks the same can still be drawn from the cached layer
+	if (!valueP || !isStatic() || valueP->value->toCode() != value->value->toCode()) {
+		viewer.invalidateLayer(*this);
+	}
 	valueP = value;
 	onValueChange();
 }
@@ -77,7 +81,7 @@ void ValueViewer::drawFieldBorder(RotatedDC& dc) {
 			alpha_mask.convexHull(points);
 			if (points.size() < 3) return;
 			FOR_EACH(p, points) p = dc.trPixelNoZoom(RealPoint(p.x,p.y));
-			dc.getDC().DrawPolygon((int)points.size(), &points[0]);
+			dc.DrawPolygon((int)points.size(), &points[0]);
 		} else {
 			// simple rectangle
 			dc.DrawRectangle(dc.getInternalRect().grow(dc.trInvS(1)));
@@ -95,6 +99,7 @@ const AlphaMask& ValueViewer::getMask(const Rotation& rot) const {
 
 
 void ValueViewer::redraw() {
+	viewer.invalidateLayer(*this);
 	viewer.redraw(*this);
 }
 
@@ -106,6 +111,7 @@ bool ValueViewer::isCurrent() const {
 }
 
 void ValueViewer::onStyleChange(int changes) {
+	viewer.invalidateLayer(*this);
 	if (!(changes & CHANGE_ALREADY_PREPARED)) {
 		viewer.redraw(*this);
 	}
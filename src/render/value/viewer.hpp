@@ -46,6 +46,10 @@ class ValueViewer : public StyleListener {
 	virtual bool prepare(RotatedDC& dc) { return false; };
 	/// Draw this value
 	virtual void draw(RotatedDC& dc) = 0;
+	/// Does this viewer usually look the same for different cards?
+	/** Static viewers at the bottom of the z-order are cached as a background layer by the DataViewer.
+	 *  Viewers for things like text and images should return false. */
+	virtual bool isStatic() const { return true; }
 	
 	/// Does this field contian the given point?
 	virtual bool containsPoint(const RealPoint& p) const;
@@ -72,6 +76,7 @@ class ValueViewer : public StyleListener {
 	virtual ValueEditor* getEditor() { return 0; }
 	
 	DataViewer& viewer;	///< Our parent object
+	RealRect drawn_box;	///< Bounding box of this viewer when it was last drawn, so the old area can be redrawn after a change
   protected:
 	ValueP valueP;		///< The value we are currently viewing
 	
@@ -15,11 +15,13 @@
 #include <data/card.hpp>
 #include <data/export_template.hpp>
 #include <data/format/formats.hpp>
+#include <data/format/image_writer.hpp>
 #include <util/tagged_string.hpp>
 #include <gfx/generated_image.hpp>
 #include <util/error.hpp>
 #include <wx/wfstream.h>
 #include <wx/filename.h>
+#include <wx/textbuf.h>
 
 DECLARE_TYPEOF_COLLECTION(SymbolFont::DrawableSymbol);
 
@@ -386,18 +388,16 @@ SCRIPT_FUNCTION(copy_file) {
 }
 
 // write a file to the destination directory
+// the file is written in the background, errors are reported when the export is finished
 SCRIPT_FUNCTION(write_text_file) {
 	guard_export_info(_("write_text_file"));
 	SCRIPT_PARAM_C(String, input); // text to write
 	SCRIPT_PARAM(String, file); // file to write to
 	// output path
 	String out_path = get_export_full_path(file);
-	// write
-	wxFileOutputStream out(out_path);
-	if (!out.Ok()) throw Error(_("Unable to open file '") + out_path + _("' for output"));
-	wxTextOutputStream tout(out);
-	tout.WriteString(BYTE_ORDER_MARK);
-	tout.WriteString(input);
+	// write, with native line endings
+	ExportInfo& ei = *export_info();
+	ei.fileWriter().writeText(BYTE_ORDER_MARK + wxTextBuffer::Translate(input), out_path);
 	SCRIPT_RETURN(file);
 }
 
@@ -415,18 +415,40 @@ SCRIPT_FUNCTION(write_image_file) {
 	SCRIPT_PARAM_C(ScriptValueP, input);
 	SCRIPT_OPTIONAL_PARAM_(int, width);
 	SCRIPT_OPTIONAL_PARAM_(int, height);
+	// how to encode png files
+	PngOptions png = ei.fileWriter().pngOptions();
+	SCRIPT_OPTIONAL_PARAM(int, png_compression) {
+		if (png_compression < 0 || png_compression > 9) {
+			throw ScriptError(_("Invalid PNG compression level, expected 0 to 9: ") + png_compression_->toString());
+		}
+		png.compression = png_compression;
+	}
+	SCRIPT_OPTIONAL_PARAM(String, png_filter) {
+		if (!parse_png_filter(png_filter, png.filter)) {
+			throw ScriptError(_("Invalid PNG filter: ") + png_filter);
+		}
+	}
 	ScriptObject<CardP>* card = dynamic_cast<ScriptObject<CardP>*>(input.get()); // is it a card?
 	Image image;
 	GeneratedImage::Options options(width, height, ei.export_template.get(), ei.set.get());
 	if (card) {
-		image = conform_image(export_bitmap(ei.set, card->getValue()).ConvertToImage(), options);
+		// drawing a card runs scripts, so that has to happen here
+		if (!ei.card_exporter) ei.card_exporter = shared(new CardBitmapExporter(ei.set));
+		image = conform_image(ei.card_exporter->exportImage(card->getValue()), options);
 	} else {
-		image = input->toImage()->generateConform(options);
+		GeneratedImageP generator = input->toImage();
+		if (generator->threadSafe() && width > 0 && height > 0) {
+			// the size of the result is known, so the image can be generated in the background as well
+			ei.fileWriter().write(generator, options, out_path, png);
+			ei.exported_images.insert(make_pair(file, wxSize(width, height)));
+			SCRIPT_RETURN(file);
+		}
+		image = generator->generateConform(options);
 	}
 	if (!image.Ok()) throw Error(_("Unable to generate image for file ") + file);
-	// write
-	image.SaveFile(out_path);
+	// encode and write in the background
 	ei.exported_images.insert(make_pair(file, wxSize(image.GetWidth(), image.GetHeight())));
+	ei.fileWriter().write(image, out_path, png); // image is empty afterwards
 	SCRIPT_RETURN(file);
 }
 
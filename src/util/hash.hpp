@@ -0,0 +1,76 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_UTIL_HASH
+#define HEADER_UTIL_HASH
+
+/** @file util/hash.hpp
+ *
+ *  @brief Utilities for computing hash values of objects.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+
+// ----------------------------------------------------------------------------- : Hashing
+
+/// Combine a hash value with the hash of another part of an object
+inline size_t hash_combine(size_t seed, size_t value) {
+	return seed ^ (value + 0x9e3779b9 + (seed << 6) + (seed >> 2));
+}
+
+/// Hash of a floating point number, equal numbers have the same hash
+inline size_t hash_double(double value) {
+	if (value == 0) return 0; // 0.0 == -0.0
+	wxUint64 bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return (size_t)(bits ^ (bits >> 32));
+}
+
+/// Hash of a string
+inline size_t hash_string(const String& str) {
+	size_t h = 0;
+	for (size_t i = 0 ; i < str.size() ; ++i) {
+		h = h * 31 + (size_t)(UInt)str.GetChar(i);
+	}
+	return h;
+}
+
+// ----------------------------------------------------------------------------- : Fingerprint
+
+/// A 64 bit hash of a sequence of strings, that is the same on every platform and in every run
+/** The hashes above may differ between builds, a fingerprint can be stored in a file
+ *  to later see whether the things it was computed from have changed. (FNV-1a)
+ */
+class Fingerprint {
+  public:
+	Fingerprint() : h(wxULL(0xcbf29ce484222325)) {}
+	
+	/// Add a string to the fingerprint
+	void add(const String& str) {
+		mix((UInt)str.size());
+		for (size_t i = 0 ; i < str.size() ; ++i) {
+			mix((UInt)str.GetChar(i));
+		}
+	}
+	/// The fingerprint as a string of 16 hexadecimal digits
+	String toString() const {
+		return String::Format(_("%08x%08x"), (UInt)(h >> 32), (UInt)(h & 0xFFFFFFFF));
+	}
+	
+  private:
+	wxUint64 h;
+	inline void mix(UInt value) {
+		for (int i = 0 ; i < 4 ; ++i) {
+			h ^= (value >> (8 * i)) & 0xFF;
+			h *= wxULL(0x100000001b3);
+		}
+	}
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
@@ -234,6 +234,31 @@ InputStreamP Package::openIn(const String& file) {
 	}
 }
 
+String Package::fileStamp(const String& file) {
+	if (!file.empty() && file.GetChar(0) == _('/')) {
+		// absolute path, the file is in another package
+		size_t start = file.find_first_not_of(_("/\\"), 1);
+		size_t pos   = file.find_first_of(_("/\\"), start);
+		if (start < pos && pos != String::npos) {
+			return package_manager.openAny(file.substr(start, pos-start))->fileStamp(file.substr(pos + 1));
+		}
+		return String();
+	}
+	if (needSaveAs()) return String(); // not on disk
+	String name = normalize_internal_filename(file);
+	DateTime time;
+	FileInfos::iterator it = files.find(name);
+	if (it != files.end()) {
+		if (it->second.wasWritten()) return String(); // changed since the package was opened
+		time = modificationTime(*it);
+	} else if (wxFileExists(filename+_("/")+name)) {
+		// a file in a directory package that was opened without a full listing
+		time = wxFileName(filename+_("/")+name).GetModificationTime();
+	}
+	if (!time.IsValid() || time.GetValue() == 0) return String();
+	return filename + _("/") + name + _("@") + time.GetValue().ToString();
+}
+
 OutputStreamP Package::openOut(const String& file) {
 	return shared(new wxFileOutputStream(nameOut(file)));
 }
@@ -14,6 +14,7 @@
 #include <util/error.hpp>
 #include <util/file_utils.hpp>
 #include <util/vcs.hpp>
+#include <util/hash.hpp>
 
 class Package;
 class wxFileInputStream;
@@ -56,6 +57,9 @@ class LocalFileName {
 	inline bool operator == (LocalFileName const& that) const {
 		return this->fn == that.fn;
 	}
+	inline size_t hash() const {
+		return hash_string(fn);
+	}
 	
   private:
 	LocalFileName(const wxString& fn) : fn(fn) {}
@@ -164,6 +168,17 @@ class Package : public IntrusivePtrVirtualBase {
 	/// Returns the name of a temporary file that can be written to.
 	FileName newFileName(const String& prefix, const String& suffix);
 
+	/// A string that identifies the current contents of a file in the package.
+	/** It includes the filename of the package and the modification time of the file,
+	 *  so it changes when the file does. This can be used as a key for caching things read from the file.
+	 *  Returns an empty string if the file can change without that being noticed,
+	 *  for example because it was written to, or the package has not been saved yet.
+	 */
+	String fileStamp(const String& file);
+	inline String fileStamp(const LocalFileName& file) {
+		return fileStamp(file.fn);
+	}
+
 	/// Signal that a file is still used by this package.
 	/// Must be called for files not opened using openOut/nameOut
 	/// If they are to be kept in the package.
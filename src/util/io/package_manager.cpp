@@ -16,6 +16,7 @@
 #include <data/locale.hpp>
 #include <data/export_template.hpp>
 #include <data/installer.hpp>
+#include <gfx/generated_image.hpp>
 #include <wx/stdpaths.h>
 #include <wx/wfstream.h>
 
@@ -38,9 +39,12 @@ void PackageManager::init() {
 }
 void PackageManager::destroy() {
 	loaded_packages.clear();
+	clear_generated_image_cache(); // it refers to packages by address
+	SymbolFont::clearImageCaches(); // the bitmaps must be freed before wx is shut down
 }
 void PackageManager::reset() {
 	loaded_packages.clear();
+	clear_generated_image_cache(); // it refers to packages by address
 }
 
 PackagedP PackageManager::openAny(const String& name_, bool just_header) {
@@ -0,0 +1,168 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_UTIL_LRU_CACHE
+#define HEADER_UTIL_LRU_CACHE
+
+/** @file util/lru_cache.hpp
+ *
+ *  @brief A map with a limited size, that forgets the least recently used items first.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <wx/thread.h>
+#include <list>
+
+// ----------------------------------------------------------------------------- : LruCacheStats
+
+/// Statistics on the use of an LruCache
+struct LruCacheStats {
+	LruCacheStats() : hits(0), misses(0), evictions(0), entries(0), cost(0), max_cost(0) {}
+
+	size_t hits;      ///< Number of successful lookups
+	size_t misses;    ///< Number of failed lookups
+	size_t evictions; ///< Number of items thrown out to stay within budget
+	size_t entries;   ///< Number of items currently in the cache
+	size_t cost;      ///< Total cost of the items currently in the cache
+	size_t max_cost;  ///< Budget for the total cost
+
+	/// Fraction of lookups that were hits
+	inline double hitRate() const {
+		return hits + misses == 0 ? 0.0 : (double)hits / (hits + misses);
+	}
+};
+
+// ----------------------------------------------------------------------------- : LruCache
+
+/// A cache from keys to values, with a budget on the total cost of the values
+/** Each value has a 'cost', usually its size in bytes.
+ *  When the total cost exceeds the budget, the least recently used values are removed.
+ *
+ *  The cache can be used from multiple threads, all operations are protected by a lock.
+ *  Note that values are copied in and out, so they should be cheap to copy (e.g. reference counted).
+ *
+ *  Key must have an operator <
+ */
+template <typename Key, typename Value>
+class LruCache {
+  public:
+	LruCache(size_t max_cost) : max_cost(max_cost), total_cost(0), hits(0), misses(0), evictions(0) {}
+
+	/// Look up a value in the cache, returns true if it was found
+	bool get(const Key& key, Value& value_out) {
+		wxCriticalSectionLocker lock(cs);
+		typename Index::iterator it = index.find(key);
+		if (it == index.end()) {
+			++misses;
+			return false;
+		}
+		// move to the front, it is now the most recently used
+		entries.splice(entries.begin(), entries, it->second);
+		value_out = it->second->value;
+		++hits;
+		return true;
+	}
+
+	/// Is there a value for the given key? Does not count as a use.
+	bool contains(const Key& key) const {
+		wxCriticalSectionLocker lock(cs);
+		return index.find(key) != index.end();
+	}
+
+	/// Add a value to the cache, replacing an existing value with the same key
+	/** Values that cost more than the whole budget are not stored. */
+	void put(const Key& key, const Value& value, size_t cost) {
+		wxCriticalSectionLocker lock(cs);
+		typename Index::iterator it = index.find(key);
+		if (it != index.end()) {
+			total_cost -= it->second->cost;
+			entries.erase(it->second);
+			index.erase(it);
+		}
+		if (cost > max_cost) return;
+		entries.push_front(Entry(key, value, cost));
+		index.insert(make_pair(key, entries.begin()));
+		total_cost += cost;
+		shrink();
+	}
+
+	/// Remove a single value from the cache
+	void remove(const Key& key) {
+		wxCriticalSectionLocker lock(cs);
+		typename Index::iterator it = index.find(key);
+		if (it == index.end()) return;
+		total_cost -= it->second->cost;
+		entries.erase(it->second);
+		index.erase(it);
+	}
+
+	/// Remove everything from the cache
+	void clear() {
+		wxCriticalSectionLocker lock(cs);
+		entries.clear();
+		index.clear();
+		total_cost = 0;
+	}
+
+	/// Change the budget, evicts values if needed
+	void setMaxCost(size_t new_max_cost) {
+		wxCriticalSectionLocker lock(cs);
+		max_cost = new_max_cost;
+		shrink();
+	}
+	inline size_t getMaxCost() const { return max_cost; }
+
+	/// Statistics on the use of this cache
+	LruCacheStats stats() const {
+		wxCriticalSectionLocker lock(cs);
+		LruCacheStats s;
+		s.hits      = hits;
+		s.misses    = misses;
+		s.evictions = evictions;
+		s.entries   = entries.size();
+		s.cost      = total_cost;
+		s.max_cost  = max_cost;
+		return s;
+	}
+	/// Reset the hit/miss counters
+	void resetStats() {
+		wxCriticalSectionLocker lock(cs);
+		hits = misses = evictions = 0;
+	}
+
+  private:
+	struct Entry {
+		Entry(const Key& key, const Value& value, size_t cost) : key(key), value(value), cost(cost) {}
+		Key    key;
+		Value  value;
+		size_t cost;
+	};
+	typedef std::list<Entry>                            Entries;
+	typedef map<Key, typename Entries::iterator>        Index;
+
+	Entries entries;    ///< All entries, most recently used first
+	Index   index;      ///< Entries by key
+	size_t  max_cost;   ///< Budget for total_cost
+	size_t  total_cost; ///< Sum of the costs of all entries
+	size_t  hits, misses, evictions;
+	mutable wxCriticalSection cs; ///< Lock protecting all of the above
+
+	/// Remove least recently used values until we are within budget
+	void shrink() {
+		while (total_cost > max_cost && !entries.empty()) {
+			Entry& e = entries.back();
+			total_cost -= e.cost;
+			index.erase(e.key);
+			entries.pop_back();
+			++evictions;
+		}
+	}
+};
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
@@ -0,0 +1,91 @@
+//+----------------------------------------------------------------------------+
+//| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+//| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+//| License:      GNU General Public License 2 or later (see file COPYING)     |
+//+----------------------------------------------------------------------------+
+
+#ifndef HEADER_UTIL_PARALLEL
+#define HEADER_UTIL_PARALLEL
+
+/** @file util/parallel.hpp
+ *
+ *  @brief Splitting work over multiple threads.
+ */
+
+// ----------------------------------------------------------------------------- : Includes
+
+#include <util/prec.hpp>
+#include <wx/thread.h>
+
+// ----------------------------------------------------------------------------- : ParallelTask
+
+/// A piece of work that can be split into independent parts, for example rows of an image
+class ParallelTask {
+  public:
+	virtual ~ParallelTask() {}
+	/// Do the work for the items [begin..end)
+	/** Can be called from multiple threads at once, for disjoint ranges.
+	 *  Should not throw exceptions.
+	 */
+	virtual void run(int begin, int end) = 0;
+};
+
+/// Thread that runs part of a ParallelTask
+class ParallelTaskThread : public wxThread {
+  public:
+	ParallelTaskThread(ParallelTask& task, int begin, int end)
+		: wxThread(wxTHREAD_JOINABLE), task(task), begin(begin), end(end)
+	{}
+	virtual ExitCode Entry() {
+		task.run(begin, end);
+		return 0;
+	}
+  private:
+	ParallelTask& task;
+	int begin, end;
+};
+
+// ----------------------------------------------------------------------------- : parallel_for
+
+/// Number of threads to use for parallel work
+inline int parallel_thread_count() {
+	return max(1, wxThread::GetCPUCount());
+}
+
+/// Run task over the items [0..count), split into bands that are done in parallel
+/** The work is only split if each band gets at least min_band items.
+ *  At most max_threads threads are used, or one per processor if max_threads <= 0.
+ *  The calling thread does the last band itself, and then waits for the others.
+ */
+inline void parallel_for(ParallelTask& task, int count, int min_band, int max_threads = 0) {
+	int thread_limit = max_threads > 0 ? min(max_threads, parallel_thread_count()) : parallel_thread_count();
+	int bands = min(thread_limit, count / max(1, min_band));
+	if (bands <= 1) {
+		task.run(0, count);
+		return;
+	}
+	// start threads for all but the last band
+	vector<ParallelTaskThread*> threads;
+	int begin = 0;
+	for (int i = 1 ; i < bands ; ++i) {
+		int end = (int)((double)count * i / bands);
+		ParallelTaskThread* thread = new ParallelTaskThread(task, begin, end);
+		if (thread->Create() == wxTHREAD_NO_ERROR && thread->Run() == wxTHREAD_NO_ERROR) {
+			threads.push_back(thread);
+		} else {
+			// no thread for us, do it ourselves
+			delete thread;
+			task.run(begin, end);
+		}
+		begin = end;
+	}
+	task.run(begin, count);
+	// wait for the others
+	for (size_t i = 0 ; i < threads.size() ; ++i) {
+		threads[i]->Wait();
+		delete threads[i];
+	}
+}
+
+// ----------------------------------------------------------------------------- : EOF
+#endif
@@ -67,6 +67,11 @@
 		inline bool matches(Results& results, const String::const_iterator& begin, const String::const_iterator& end) const {
 			return regex_search(begin, end, results, regex);
 		}
+		/// Does the regex match a prefix of [begin..end)?
+		/** Unlike matches, this does not search the rest of the string */
+		inline bool matchesPrefix(Results& results, const String::const_iterator& begin, const String::const_iterator& end) const {
+			return regex_search(begin, end, results, regex, boost::match_continuous);
+		}
 		void replace_all(String* input, const String& format);
 		
 		inline bool empty() const {
@@ -146,6 +151,9 @@
 			results.begin = begin;
 			return regex.Matches(begin, 0, end - begin);
 		}
+		inline bool matchesPrefix(Results& results, const Char* begin, const Char* end) const {
+			return matches(results, begin, end) && results.position() == 0;
+		}
 		inline void replace_all(String* input, const String& format) {
 			regex.Replace(input, format);
 		}
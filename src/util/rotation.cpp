@@ -9,7 +9,9 @@
 #include <util/prec.hpp>
 #include <util/rotation.hpp>
 #include <gfx/gfx.hpp>
+#include <gfx/software_canvas.hpp>
 #include <data/font.hpp>
+#include <gui/util.hpp> // clearDC
 
 // ----------------------------------------------------------------------------- : Rotation
 
@@ -172,12 +174,18 @@ Rotater::~Rotater() {
 
 RotatedDC::RotatedDC(DC& dc, Radians angle, const RealRect& rect, double zoom, RenderQuality quality, RotationFlags flags)
 	: Rotation(angle, rect, zoom, 1.0, flags)
-	, dc(dc), quality(quality)
+	, dc(dc), canvas(nullptr), quality(quality)
 {}
 
 RotatedDC::RotatedDC(DC& dc, const Rotation& rotation, RenderQuality quality)
 	: Rotation(rotation)
-	, dc(dc), quality(quality)
+	, dc(dc), canvas(nullptr), quality(quality)
+{}
+
+RotatedDC::RotatedDC(SoftwareCanvas& canvas, const Rotation& rotation)
+	: Rotation(rotation)
+	, dc(canvas.getMeasuringDC()), canvas(&canvas)
+	, quality(QUALITY_AA)
 {}
 
 // ----------------------------------------------------------------------------- : RotatedDC : Drawing
@@ -202,7 +210,15 @@ void RotatedDC::DrawText  (const String& text, const RealPoint& pos, AColor colo
 			r_ext.x = r_ext2.x;
 			r_ext.y = r_ext2.y;
 		}
-		draw_resampled_text(dc, pos2, r_ext, stretch_, angle, color, text, blur_radius, boldness);
+		if (canvas) {
+			wxPoint pos_out;
+			Image img = resampled_text_image(dc, pos2, r_ext, stretch_, angle, color, text, blur_radius, pos_out);
+			for (int i = 0 ; i < boldness ; ++i) {
+				canvas->DrawImage(img, pos_out.x, pos_out.y);
+			}
+		} else {
+			draw_resampled_text(dc, pos2, r_ext, stretch_, angle, color, text, blur_radius, boldness);
+		}
 	} else if (quality >= QUALITY_SUB_PIXEL) {
 		RealPoint p_ext = tr(pos)*text_scaling;
 		double usx,usy;
@@ -226,7 +242,11 @@ void RotatedDC::DrawTextWithShadow(const String& text, const Font& font, const R
 void RotatedDC::DrawBitmap(const Bitmap& bitmap, const RealPoint& pos) {
 	if (is_rad0(angle)) {
 		RealPoint p_ext = tr(pos);
-		dc.DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+		if (canvas) {
+			canvas->DrawImage(bitmap.ConvertToImage(), to_int(p_ext.x), to_int(p_ext.y));
+		} else {
+			dc.DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+		}
 	} else {
 		DrawImage(bitmap.ConvertToImage(), pos);
 	}
@@ -237,35 +257,55 @@ void RotatedDC::DrawImage(const Image& image, const RealPoint& pos, ImageCombine
 }
 void RotatedDC::DrawPreRotatedBitmap(const Bitmap& bitmap, const RealRect& rect) {
 	RealPoint p_ext = tr(rect.position()) + boundingBoxCorner(rect.size());
-	dc.DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+	if (canvas) {
+		canvas->DrawImage(bitmap.ConvertToImage(), to_int(p_ext.x), to_int(p_ext.y));
+	} else {
+		dc.DrawBitmap(bitmap, to_int(p_ext.x), to_int(p_ext.y), true);
+	}
 }
 void RotatedDC::DrawPreRotatedImage (const Image& image, const RealRect& rect, ImageCombine combine) {
 	RealPoint p_ext = tr(rect.position()) + boundingBoxCorner(rect.size());
-	draw_combine_image(dc, to_int(p_ext.x), to_int(p_ext.y), image, combine);
+	if (canvas) {
+		canvas->DrawImage(image, to_int(p_ext.x), to_int(p_ext.y), combine);
+	} else {
+		draw_combine_image(dc, to_int(p_ext.x), to_int(p_ext.y), image, combine);
+	}
 }
 
 void RotatedDC::DrawLine  (const RealPoint& p1,  const RealPoint& p2) {
 	wxPoint p1_ext = tr(p1), p2_ext = tr(p2);
-	dc.DrawLine(p1_ext.x, p1_ext.y, p2_ext.x, p2_ext.y);
+	if (canvas) {
+		canvas->DrawLine(p1_ext, p2_ext);
+	} else {
+		dc.DrawLine(p1_ext.x, p1_ext.y, p2_ext.x, p2_ext.y);
+	}
 }
 
 void RotatedDC::DrawRectangle(const RealRect& r) {
 	if (is_straight(angle)) {
 		wxRect r_ext = trRectToBB(r);
-		dc.DrawRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height);
+		if (canvas) {
+			canvas->DrawRectangle(r_ext);
+		} else {
+			dc.DrawRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height);
+		}
 	} else {
 		wxPoint points[4] = {trPixel(RealPoint(r.left(),  r.top()   ))
 		                    ,trPixel(RealPoint(r.left(),  r.bottom()))
 		                    ,trPixel(RealPoint(r.right(), r.bottom()))
 		                    ,trPixel(RealPoint(r.right(), r.top()   ))};
-		dc.DrawPolygon(4,points);
+		DrawPolygon(4,points);
 	}
 }
 
 void RotatedDC::DrawRoundedRectangle(const RealRect& r, double radius) {
 	if (is_straight(angle)) {
 		wxRect r_ext = trRectToBB(r);
-		dc.DrawRoundedRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height, trS(radius));
+		if (canvas) {
+			canvas->DrawRoundedRectangle(r_ext, trS(radius));
+		} else {
+			dc.DrawRoundedRectangle(r_ext.x, r_ext.y, r_ext.width, r_ext.height, trS(radius));
+		}
 	} else {
 		// TODO
 		DrawRectangle(r);
@@ -274,18 +314,31 @@ void RotatedDC::DrawRoundedRectangle(const RealRect& r, double radius) {
 
 void RotatedDC::DrawCircle(const RealPoint& center, double radius) {
 	wxPoint p = tr(center);
-	dc.DrawCircle(p.x + 1, p.y + 1, int(trS(radius)));
+	if (canvas) {
+		int r = int(trS(radius));
+		canvas->DrawEllipse(wxRect(p.x + 1 - r, p.y + 1 - r, 2 * r, 2 * r));
+	} else {
+		dc.DrawCircle(p.x + 1, p.y + 1, int(trS(radius)));
+	}
 }
 
 void RotatedDC::DrawEllipse(const RealPoint& center, const RealSize& size) {
 	wxPoint c_ext = tr(center - size/2);
 	wxSize  s_ext = trSizeToBB(size);
-	dc.DrawEllipse(c_ext.x, c_ext.y, s_ext.x, s_ext.y);
+	if (canvas) {
+		canvas->DrawEllipse(wxRect(c_ext, s_ext));
+	} else {
+		dc.DrawEllipse(c_ext.x, c_ext.y, s_ext.x, s_ext.y);
+	}
 }
 void RotatedDC::DrawEllipticArc(const RealPoint& center, const RealSize& size, Radians start, Radians end) {
 	wxPoint c_ext = tr(center - size/2);
 	wxSize  s_ext = trSizeToBB(size);
-	dc.DrawEllipticArc(c_ext.x, c_ext.y, s_ext.x, s_ext.y, rad_to_deg(start + angle), rad_to_deg(end + angle));
+	if (canvas) {
+		canvas->DrawEllipticArc(wxRect(c_ext, s_ext), rad_to_deg(start + angle), rad_to_deg(end + angle));
+	} else {
+		dc.DrawEllipticArc(c_ext.x, c_ext.y, s_ext.x, s_ext.y, rad_to_deg(start + angle), rad_to_deg(end + angle));
+	}
 }
 void RotatedDC::DrawEllipticSpoke(const RealPoint& center, const RealSize& size, Radians angle) {
 	wxPoint c_ext = tr(center - size/2);
@@ -294,20 +347,48 @@ void RotatedDC::DrawEllipticSpoke(const RealPoint& center, const RealSize& size,
 	Radians sin_angle = sin(rot_angle), cos_angle = cos(rot_angle);
 	// position of center and of point on the boundary can vary because of rounding errors,
 	// this code matches DrawEllipticArc (at least on windows xp).
-	dc.DrawLine(
-		c_ext.x + int(       0.5 * (s_ext.x + cos_angle) ), // center
-		c_ext.y + int(       0.5 * (s_ext.y - sin_angle) ),
-		c_ext.x + int( 0.5 + 0.5 * (s_ext.x-1) * (1 + cos_angle) ), // boundary
-		c_ext.y + int( 0.5 + 0.5 * (s_ext.y-1) * (1 - sin_angle) )
-	);
+	wxPoint p1(c_ext.x + int(       0.5 * (s_ext.x + cos_angle) ), // center
+	           c_ext.y + int(       0.5 * (s_ext.y - sin_angle) ));
+	wxPoint p2(c_ext.x + int( 0.5 + 0.5 * (s_ext.x-1) * (1 + cos_angle) ), // boundary
+	           c_ext.y + int( 0.5 + 0.5 * (s_ext.y-1) * (1 - sin_angle) ));
+	if (canvas) {
+		canvas->DrawLine(p1, p2);
+	} else {
+		dc.DrawLine(p1, p2);
+	}
+}
+
+void RotatedDC::DrawPolygon(int n, wxPoint points[]) {
+	if (canvas) {
+		canvas->DrawPolygon(n, points);
+	} else {
+		dc.DrawPolygon(n, points);
+	}
+}
+
+void RotatedDC::Clear(const Color& color) {
+	if (canvas) {
+		canvas->Clear(color);
+	} else {
+		clearDC(dc, color);
+	}
 }
 
 // ----------------------------------------------------------------------------- : Forwarded properties
 
-void RotatedDC::SetPen(const wxPen& pen)              { dc.SetPen(pen); }
-void RotatedDC::SetBrush(const wxBrush& brush)        { dc.SetBrush(brush); }
+void RotatedDC::SetPen(const wxPen& pen) {
+	if (canvas) canvas->SetPen(pen);
+	else        dc.SetPen(pen);
+}
+void RotatedDC::SetBrush(const wxBrush& brush) {
+	if (canvas) canvas->SetBrush(brush);
+	else        dc.SetBrush(brush);
+}
 void RotatedDC::SetTextForeground(const Color& color) { dc.SetTextForeground(color); }
-void RotatedDC::SetLogicalFunction(wxRasterOperationMode function)      { dc.SetLogicalFunction(function); }
+void RotatedDC::SetLogicalFunction(wxRasterOperationMode function) {
+	if (canvas) canvas->SetLogicalFunction(function);
+	else        dc.SetLogicalFunction(function);
+}
 
 void RotatedDC::SetFont(const wxFont& font) {
 	if (quality == QUALITY_LOW && zoomX == 1 && zoomY == 1) {
@@ -366,16 +447,22 @@ double RotatedDC::GetCharHeight() const {
 }
 
 void RotatedDC::SetClippingRegion(const RealRect& rect) {
-	dc.SetDeviceClippingRegion(trRectToRegion(rect));
+	SetClippingRegion(trRectToRegion(rect));
+}
+void RotatedDC::SetClippingRegion(const wxRegion& region) {
+	if (canvas) canvas->SetClippingRegion(region);
+	else        dc.SetDeviceClippingRegion(region);
 }
 void RotatedDC::DestroyClippingRegion() {
-	dc.DestroyClippingRegion();
+	if (canvas) canvas->DestroyClippingRegion();
+	else        dc.DestroyClippingRegion();
 }
 
 // ----------------------------------------------------------------------------- : Other
 
 Bitmap RotatedDC::GetBackground(const RealRect& r) {
 	wxRect wr = trRectToBB(r);
+	if (canvas) return Bitmap(canvas->GetSubImage(wr));
 	Bitmap background(wr.width, wr.height);
 	wxMemoryDC mdc;
 	mdc.SelectObject(background);
@@ -383,3 +470,7 @@ Bitmap RotatedDC::GetBackground(const RealRect& r) {
 	mdc.SelectObject(wxNullBitmap);
 	return background;
 }
+Image RotatedDC::GetBackgroundImage(const RealRect& r) {
+	if (canvas) return canvas->GetSubImage(trRectToBB(r));
+	return GetBackground(r).ConvertToImage();
+}
@@ -14,6 +14,7 @@
 #include <gfx/gfx.hpp>
 
 class Font;
+class SoftwareCanvas;
 
 // ----------------------------------------------------------------------------- : Rotation
 
@@ -149,11 +150,16 @@ enum RenderQuality {
 
 /// A DC with rotation applied
 /** All draw** functions take internal coordinates.
+ *
+ *  Instead of a DC, a SoftwareCanvas can be used as the target, then images and shapes are
+ *  composited in memory. Text is always drawn anti-aliased in that case.
  */
 class RotatedDC : public Rotation {
   public:
 	RotatedDC(DC& dc, Radians angle, const RealRect& rect, double zoom, RenderQuality quality, RotationFlags flags = ROTATION_NORMAL);
 	RotatedDC(DC& dc, const Rotation& rotation, RenderQuality quality);
+	/// Draw to a canvas, always with QUALITY_AA, since text can only be drawn to a canvas as an image
+	RotatedDC(SoftwareCanvas& canvas, const Rotation& rotation);
 	
 	// --------------------------------------------------- : Drawing
 	
@@ -180,9 +186,13 @@ class RotatedDC : public Rotation {
 	void DrawEllipticArc(const RealPoint& center, const RealSize& size, Radians start, Radians end);
 	/// Draw spokes of an ellipse
 	void DrawEllipticSpoke(const RealPoint& center, const RealSize& size, Radians start);
+	/// Draw a polygon, the points are in external coordinates (i.e. pixels)
+	void DrawPolygon(int n, wxPoint points[]);
 	
 	// Fill the dc with the color of the current brush
 	void Fill();
+	/// Fill the whole dc with a color
+	void Clear(const Color& color);
 	
 	// --------------------------------------------------- : Properties
 	
@@ -203,17 +213,25 @@ class RotatedDC : public Rotation {
 	double GetCharHeight() const;
 	
 	void SetClippingRegion(const RealRect& rect);
+	/// Set the clipping region, in external coordinates
+	void SetClippingRegion(const wxRegion& region);
 	void DestroyClippingRegion();
 	
 	// --------------------------------------------------- : Other
 	
 	/// Get the current contents of the given ractangle, for later restoring
 	Bitmap GetBackground(const RealRect& r);
+	/// Get the current contents of the given ractangle as an image
+	Image GetBackgroundImage(const RealRect& r);
 	
+	/// The dc being drawn on. When drawing to a canvas, drawing to this dc has no effect
 	inline wxDC& getDC() { return dc; }
+	/// Are we drawing to a SoftwareCanvas instead of a DC?
+	inline bool isOffscreen() const { return canvas != nullptr; }
 	
   private:
 	wxDC& dc;				///< The actual dc
+	SoftwareCanvas* canvas;	///< Canvas to draw on instead of dc, if any
 	RenderQuality quality;	///< Quality of the text
 };
 
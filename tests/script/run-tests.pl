@@ -7,6 +7,7 @@
 use strict;
 use lib "../util/";
 use MseTestUtils;
+use ImageTestUtils;
 use TestFramework;
 
 # -----------------------------------------------------------------------------
@@ -31,6 +32,34 @@ test_case("script/Magic Funcions", sub{
 	compare_files("test-magic.out", "expected-out/test-magic.out");
 });
 
+test_case("script/Image combining modes", sub{
+	write_combine_inputs("combine-a.bmp", "combine-b.bmp");
+	run_script_test("test-combine.mse-script", cleanup => 1);
+	foreach my $mode (combine_modes()) {
+		my $name = $mode;
+		$name =~ s/ /-/g;
+		check_combine_output($mode, "combine-$name.out.bmp");
+		unlink("combine-$name.out.bmp");
+	}
+	unlink("combine-a.bmp");
+	unlink("combine-b.bmp");
+});
+
+test_case("script/PNG encoder", sub{
+	write_png_inputs("png-input.bmp", "png-mask.bmp");
+	run_script_test("test-png-encode.mse-script", cleanup => 1);
+	run_script_test("test-png-decode.mse-script", cleanup => 1);
+	foreach my $filter (png_filters()) {
+		foreach my $level (png_levels()) {
+			# decoded by wxImage and saved as a bitmap
+			check_png_output("png-$filter-$level.out.bmp");
+			# decoded by wxImage and encoded again without compression, gives the same file if the pixels are the same
+			compare_files("png-$filter-$level-alpha.again.png", "png-none-0-alpha.out.png");
+		}
+	}
+	unlink(glob("png-*.out.*"), glob("png-*.again.png"), "png-input.bmp", "png-mask.bmp");
+});
+
 test_case("compatability/2.0.0", sub{
 	mkdir("out");
 	run_export_test("magic-forum", "simple-magic-2.0.0.mse-set", "out/simple-magic-2.0.0.txt", cleanup => 1);
@@ -0,0 +1,211 @@
+#+----------------------------------------------------------------------------+
+#| Description:  Magic Set Editor - Program to make Magic (tm) cards          |
+#| Copyright:    (C) 2001 - 2012 Twan van Laarhoven and Sean Hunt             |
+#| License:      GNU General Public License 2 or later (see file COPYING)     |
+#+----------------------------------------------------------------------------+
+
+package ImageTestUtils;
+
+require Exporter;
+@ISA = qw(Exporter);
+@EXPORT = qw(write_bmp read_bmp combine_modes combine_reference write_combine_inputs check_combine_output
+             png_filters png_levels write_png_inputs check_png_output);
+
+use strict;
+use warnings;
+
+# -----------------------------------------------------------------------------
+# Bitmap files
+# -----------------------------------------------------------------------------
+
+# Write an uncompressed 24 bit bmp file
+# Usage:  write_bmp("file.bmp", width, height, sub{ my ($x,$y) = @_; return ($r,$g,$b); });
+sub write_bmp {
+	my ($filename, $width, $height, $pixel) = @_;
+	my $stride = ($width * 3 + 3) & ~3;
+	my $data = '';
+	for (my $y = $height - 1 ; $y >= 0 ; --$y) { # bottom up
+		my $row = '';
+		for (my $x = 0 ; $x < $width ; ++$x) {
+			my ($r,$g,$b) = &$pixel($x,$y);
+			$row .= pack('CCC', $b, $g, $r);
+		}
+		$data .= $row . ("\0" x ($stride - length($row)));
+	}
+	open FILE,"> $filename" or die("Unable to write $filename");
+	binmode FILE;
+	print FILE pack('a2 V v v V', 'BM', 54 + length($data), 0, 0, 54);
+	print FILE pack('V l l v v V V l l V V', 40, $width, $height, 1, 24, 0, length($data), 2835, 2835, 0, 0);
+	print FILE $data;
+	close FILE;
+}
+
+# Read an uncompressed 24 or 32 bit bmp file
+# Returns (width, height, [[r,g,b], ...]) with the pixels row by row, top to bottom
+sub read_bmp {
+	my $filename = shift;
+	open FILE,"< $filename" or die("Unable to read $filename");
+	binmode FILE;
+	local $/;
+	my $file = <FILE>;
+	close FILE;
+	my ($magic, $offset) = unpack('a2 x8 V', $file);
+	my ($width, $height, $bits, $compression) = unpack('x18 l l x2 v V', $file);
+	die("Not a bmp file: $filename") if ($magic ne 'BM');
+	die("Unsupported bmp format in $filename: $bits bits, compression $compression")
+		if (($bits != 24 && $bits != 32) || ($compression != 0 && $compression != 3));
+	my $bytes  = $bits / 8;
+	my $stride = ($width * $bytes + 3) & ~3;
+	my @pixels;
+	for (my $y = 0 ; $y < abs($height) ; ++$y) {
+		my $row = $height > 0 ? abs($height) - 1 - $y : $y;
+		for (my $x = 0 ; $x < $width ; ++$x) {
+			my ($b,$g,$r) = unpack('CCC', substr($file, $offset + $row * $stride + $x * $bytes, 3));
+			push @pixels, [$r,$g,$b];
+		}
+	}
+	return ($width, abs($height), \@pixels);
+}
+
+# -----------------------------------------------------------------------------
+# Combining modes
+# -----------------------------------------------------------------------------
+
+# The formulas for combining modes, as they were before combine_image used lookup tables,
+# see src/gfx/combine_image.cpp
+
+sub top { my $x = shift; return $x > 255 ? 255 : $x; }
+sub bot { my $x = shift; return $x < 0   ? 0   : $x; }
+sub col { return top(bot(shift)); }
+sub div { return int($_[0] / $_[1]); } # integer division, the operands are never negative
+
+sub overlay {
+	my ($a, $b) = @_;
+	return $a < 128 ? ($a * $b) >> 7 : 255 - (((255 - $a) * (255 - $b)) >> 7);
+}
+
+my %combine_functions = (
+	'normal'            => sub { my ($a,$b) = @_; $b },
+	'add'               => sub { my ($a,$b) = @_; top($a + $b) },
+	'subtract'          => sub { my ($a,$b) = @_; bot($a - $b) },
+	'stamp'             => sub { my ($a,$b) = @_; col($a - 2 * $b + 256) },
+	'difference'        => sub { my ($a,$b) = @_; abs($a - $b) },
+	'negation'          => sub { my ($a,$b) = @_; 255 - abs(255 - $a - $b) },
+	'multiply'          => sub { my ($a,$b) = @_; div($a * $b, 255) },
+	'darken'            => sub { my ($a,$b) = @_; $a < $b ? $a : $b },
+	'lighten'           => sub { my ($a,$b) = @_; $a > $b ? $a : $b },
+	'color dodge'       => sub { my ($a,$b) = @_; $b == 255 ? 255 : top(div($a * 255, 255 - $b)) },
+	'color burn'        => sub { my ($a,$b) = @_; $b == 0   ? 0   : bot(255 - div((255 - $a) * 255, $b)) },
+	'screen'            => sub { my ($a,$b) = @_; 255 - div((255 - $a) * (255 - $b), 255) },
+	'overlay'           => sub { my ($a,$b) = @_; overlay($a, $b) },
+	'hard light'        => sub { my ($a,$b) = @_; $b < 128 ? ($a * $b) >> 7 : 255 - (((255 - $a) * (255 - $b)) >> 7) },
+	'soft light'        => sub { my ($a,$b) = @_; $b },
+	'reflect'           => sub { my ($a,$b) = @_; $b == 255 ? 255 : top(div($a * $a, 255 - $b)) },
+	'glow'              => sub { my ($a,$b) = @_; $a == 255 ? 255 : top(div($b * $b, 255 - $a)) },
+	'freeze'            => sub { my ($a,$b) = @_; $b == 0 ? 0 : bot(255 - div((255 - $a) * (255 - $a), $b)) },
+	'heat'              => sub { my ($a,$b) = @_; $a == 0 ? 0 : bot(255 - div((255 - $b) * (255 - $b), $a)) },
+	'and'               => sub { my ($a,$b) = @_; $a & $b },
+	'or'                => sub { my ($a,$b) = @_; $a | $b },
+	'xor'               => sub { my ($a,$b) = @_; $a ^ $b },
+	'shadow'            => sub { my ($a,$b) = @_; div($b * $a * $a, 255 * 255) },
+	'symmetric overlay' => sub { my ($a,$b) = @_; div(overlay($a, $b) + overlay($b, $a), 2) },
+);
+
+# Names of all combining modes
+sub combine_modes {
+	return sort keys %combine_functions;
+}
+
+# Combine channel value b onto a
+sub combine_reference {
+	my ($mode, $a, $b) = @_;
+	my $f = $combine_functions{$mode} or die("Unknown combining mode: $mode");
+	return &$f($a, $b);
+}
+
+# The two input images, together they contain every pair of channel values
+sub input_a { my ($x,$y) = @_; return ($x, $y, $x ^ $y); }
+sub input_b { my ($x,$y) = @_; return ($y, $x, 255 - $y); }
+
+sub write_combine_inputs {
+	my ($file_a, $file_b) = @_;
+	write_bmp($file_a, 256, 256, \&input_a);
+	write_bmp($file_b, 256, 256, \&input_b);
+}
+
+# Compare the result of combining the inputs with the reference formulas
+sub check_combine_output {
+	my ($mode, $filename) = @_;
+	my ($width, $height, $pixels) = read_bmp($filename);
+	die("Wrong size of $filename: ${width}x$height") if ($width != 256 || $height != 256);
+	my $f = $combine_functions{$mode} or die("Unknown combining mode: $mode");
+	for (my $y = 0 ; $y < 256 ; ++$y) {
+		for (my $x = 0 ; $x < 256 ; ++$x) {
+			my @a = input_a($x,$y);
+			my @b = input_b($x,$y);
+			my $out = $pixels->[$y * 256 + $x];
+			for (my $c = 0 ; $c < 3 ; ++$c) {
+				my $expected = &$f($a[$c], $b[$c]);
+				if ($out->[$c] != $expected) {
+					die("Combine mode '$mode' differs at ($x,$y) channel $c: $a[$c] with $b[$c] gives $out->[$c], expected $expected\n");
+				}
+			}
+		}
+	}
+}
+
+# -----------------------------------------------------------------------------
+# PNG encoding
+# -----------------------------------------------------------------------------
+
+# The images are large enough to be compressed in more than one block, see src/gfx/png_encoder.cpp
+my $png_width  = 300;
+my $png_height = 500;
+
+# Filters and compression levels to test
+sub png_filters { return qw(none sub up average paeth adaptive); }
+sub png_levels  { return (0, 1, 9); }
+
+# Input image: gradients in the top half, noise in the bottom half
+sub png_input {
+	my ($x,$y) = @_;
+	if ($y < $png_height / 2) {
+		return (($x + $y) & 255, ($x * 2) & 255, ($y * 3) & 255);
+	} else {
+		my $h = ($x * 2654435761 + $y * 40503) % 16777216;
+		return ($h & 255, ($h >> 8) & 255, ($h >> 16) & 255);
+	}
+}
+# Mask for the input with alpha, never fully transparent or opaque, so the alpha channel is kept when loading
+sub png_mask {
+	my ($x,$y) = @_;
+	my $a = 16 + ($x * 3 + $y) % 224;
+	return ($a, $a, $a);
+}
+
+sub write_png_inputs {
+	my ($file_input, $file_mask) = @_;
+	write_bmp($file_input, $png_width, $png_height, \&png_input);
+	write_bmp($file_mask,  $png_width, $png_height, \&png_mask);
+}
+
+# Compare a decoded image with the input image
+sub check_png_output {
+	my $filename = shift;
+	my ($width, $height, $pixels) = read_bmp($filename);
+	die("Wrong size of $filename: ${width}x$height") if ($width != $png_width || $height != $png_height);
+	for (my $y = 0 ; $y < $height ; ++$y) {
+		for (my $x = 0 ; $x < $width ; ++$x) {
+			my @expected = png_input($x,$y);
+			my $out = $pixels->[$y * $width + $x];
+			for (my $c = 0 ; $c < 3 ; ++$c) {
+				if ($out->[$c] != $expected[$c]) {
+					die("Decoded image $filename differs at ($x,$y) channel $c: $out->[$c], expected $expected[$c]\n");
+				}
+			}
+		}
+	}
+}
+
+# -----------------------------------------------------------------------------
+1;